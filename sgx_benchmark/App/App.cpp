@@ -38,13 +38,18 @@
 #include <sched.h>
 #include <sys/io.h>
 #include <sys/mman.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <cpuid.h>
 # include <unistd.h>
 # include <pwd.h>
 # define MAX_PATH FILENAME_MAX
 
 #include "sgx_urts.h"
+#include "sgx_uswitchless.h"
 #include "App.h"
 #include "Enclave_u.h"
+#include "histogram.h"
 
 
 /* Global EID shared by multiple threads */
@@ -154,21 +159,83 @@ void print_error_message(sgx_status_t ret)
     	printf("Error code is 0x%X. Please refer to the \"Intel SGX SDK Developer Reference\" for more details.\n", ret);
 }
 
+/* Path of the image signed with config, -1 if it was not built */
+static int enclave_image(const char* config, char* path, size_t len)
+{
+    snprintf(path, len, ENCLAVE_IMAGE_FORMAT, config);
+    if (access(path, R_OK) != 0) {
+        printf("Error: %s not found, is Enclave/%s-Enclave.config.xml or Enclave/%s.xml missing?\n",
+                path, config, config);
+        return -1;
+    }
+    return 0;
+}
+
 /* Initialize the enclave:
- *   Call sgx_create_enclave to initialize an enclave instance
+ *   Call sgx_create_enclave to initialize an instance of the image signed
+ *   with the named config
  */
-int initialize_enclave(void)
+int initialize_enclave(const char* config)
 {
     sgx_status_t ret = SGX_ERROR_UNEXPECTED;
-    
+    char path[256];
+
+    if (enclave_image(config, path, sizeof(path)) < 0)
+        return -1;
+
     /* Call sgx_create_enclave to initialize an enclave instance */
     /* Debug Support: set 2nd parameter to 1 */
-    ret = sgx_create_enclave(ENCLAVE_FILENAME, SGX_DEBUG_FLAG, NULL, NULL, &global_eid, NULL);
+    ret = sgx_create_enclave(path, SGX_DEBUG_FLAG, NULL, NULL, &global_eid, NULL);
+    if (ret != SGX_SUCCESS) {
+        print_error_message(ret);
+        return -1;
+    }
+
+    ecall_timing_init(global_eid, timing.tsc_hz);
+    return 0;
+}
+
+/* Report how many switchless requests each worker served and how many
+ * times it found the queue empty; missed calls fell back to EENTER/EEXIT.
+ */
+static void switchless_worker_exit_callback(sgx_uswitchless_worker_type_t type,
+                                            sgx_uswitchless_worker_event_t event,
+                                            const sgx_uswitchless_worker_stats_t* stats)
+{
+    (void)event;
+    printf("Info: %s switchless worker exit, processed: %lu, missed: %lu\n",
+            type == SGX_USWITCHLESS_WORKER_TYPE_UNTRUSTED ? "untrusted" : "trusted",
+            (unsigned long)stats->processed, (unsigned long)stats->missed);
+}
+
+/* Initialize the enclave with switchless calls enabled:
+ *   num_uworkers untrusted threads serve switchless OCALLs,
+ *   num_tworkers trusted threads serve switchless ECALLs (each needs a TCS).
+ */
+int initialize_switchless_enclave(const char* config, unsigned int num_uworkers, unsigned int num_tworkers)
+{
+    sgx_status_t ret = SGX_ERROR_UNEXPECTED;
+    char path[256];
+
+    if (enclave_image(config, path, sizeof(path)) < 0)
+        return -1;
+
+    sgx_uswitchless_config_t us_config = SGX_USWITCHLESS_CONFIG_INITIALIZER;
+    us_config.num_uworkers = num_uworkers;
+    us_config.num_tworkers = num_tworkers;
+    us_config.callback_func[SGX_USWITCHLESS_WORKER_EVENT_EXIT] = switchless_worker_exit_callback;
+
+    const void* enclave_ex_p[32] = { 0 };
+    enclave_ex_p[SGX_CREATE_ENCLAVE_EX_SWITCHLESS_BIT_IDX] = (const void*)&us_config;
+
+    ret = sgx_create_enclave_ex(path, SGX_DEBUG_FLAG, NULL, NULL, &global_eid, NULL,
+                                SGX_CREATE_ENCLAVE_EX_SWITCHLESS, enclave_ex_p);
     if (ret != SGX_SUCCESS) {
         print_error_message(ret);
         return -1;
     }
 
+    ecall_timing_init(global_eid, timing.tsc_hz);
     return 0;
 }
 
@@ -189,151 +256,692 @@ void ocall_out(long* out, int len) {}
 
 void ocall_inout(long* inout, int len) {}
 
-uint64_t rdtsc()
+volatile long payload_sink = 0;
+
+static void payload_read(const long* buf, int len) {
+    long sum = 0;
+    for (int i = 0; i < len; ++i) sum += buf[i];
+    payload_sink = sum;
+}
+
+static void payload_write(long* buf, int len) {
+    for (int i = 0; i < len; ++i) buf[i] = i;
+}
+
+void ocall_in_read(long* in, int len) { payload_read(in, len); }
+
+void ocall_out_write(long* out, int len) { payload_write(out, len); }
+
+void ocall_user_check_read(long* in, int len) { payload_read(in, len); }
+
+void ocall_user_check_write(long* out, int len) { payload_write(out, len); }
+
+void ocall_void_switchless(void) {}
+
+void ocall_in_switchless(long* in, int len) {}
+
+void ocall_out_switchless(long* out, int len) {}
+
+void ocall_inout_switchless(long* inout, int len) {}
+
+timing_t timing = { 0, 0 };
+
+/* TSC frequency from CPUID leaf 0x15 (crystal clock * ratio) when the CPU
+ * enumerates it, otherwise counted against CLOCK_MONOTONIC_RAW for 100 ms.
+ */
+static uint64_t calibrate_tsc_hz(const char** source)
 {
-	unsigned int lo, hi;
-	__asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
-	return ((uint64_t)hi << 32) | lo;
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid_max(0, NULL) >= 0x15) {
+        __cpuid_count(0x15, 0, eax, ebx, ecx, edx);
+        if (eax != 0 && ebx != 0 && ecx != 0) {
+            *source = "cpuid";
+            return (uint64_t)ecx * ebx / eax;
+        }
+    }
+
+    struct timespec start_ts, stop_ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &start_ts);
+    uint64_t start_tsc = rdtsc();
+    do {
+        clock_gettime(CLOCK_MONOTONIC_RAW, &stop_ts);
+    } while ((stop_ts.tv_sec - start_ts.tv_sec) * 1000000000L + (stop_ts.tv_nsec - start_ts.tv_nsec) < 100000000L);
+    uint64_t stop_tsc = rdtscp();
+
+    double ns = (double)(stop_ts.tv_sec - start_ts.tv_sec) * 1e9 + (double)(stop_ts.tv_nsec - start_ts.tv_nsec);
+    *source = "measured";
+    return (uint64_t)((double)(stop_tsc - start_tsc) * 1e9 / ns);
+}
+
+/* timing_init:
+ *   Measure the timer overhead and the TSC frequency for the untrusted side.
+ */
+void timing_init(void)
+{
+    const char* source = "";
+    timing.overhead = timing_measure_overhead(1000);
+    timing.tsc_hz = calibrate_tsc_hz(&source);
+    printf("Info: tsc frequency is %.3f GHz (%s), timer overhead is %lu cycles\n",
+            (double)timing.tsc_hz / 1e9, source, (unsigned long)timing.overhead);
+}
+
+void print_switching_hist(const char* name, const histogram_t* hist, const stats_result_t* stats) {
+    char mean[160], percentiles[256];
+    stats_format_cycles(stats, mean, sizeof(mean));
+    hist_format(hist, percentiles, sizeof(percentiles));
+    printf("%s switching time is %s, %s\n", name, mean, percentiles);
+    results_add(name, "cycles", stats);
 }
 
+typedef struct _payload_t {
+    long* ptr;
+    int len;
+    unsigned long loops;
+} payload_t;
+
+static void call_ecall_void(void* arg) { ecall_void(global_eid); }
+static void call_ecall_in(void* arg) { payload_t* p = (payload_t*)arg; ecall_in(global_eid, p->ptr, p->len); }
+static void call_ecall_out(void* arg) { payload_t* p = (payload_t*)arg; ecall_out(global_eid, p->ptr, p->len); }
+static void call_ecall_inout(void* arg) { payload_t* p = (payload_t*)arg; ecall_inout(global_eid, p->ptr, p->len); }
+
+/* OCALLs are timed one by one inside the enclave */
+static void run_ocall_void(void* arg, histogram_t* hist) {
+    ecall_ocall_void(global_eid, (int)((payload_t*)arg)->loops);
+    ecall_get_ocall_histogram(global_eid, hist);
+}
+static void run_ocall_in(void* arg, histogram_t* hist) {
+    payload_t* p = (payload_t*)arg;
+    ecall_ocall_in(global_eid, (int)p->loops, p->len);
+    ecall_get_ocall_histogram(global_eid, hist);
+}
+static void run_ocall_out(void* arg, histogram_t* hist) {
+    payload_t* p = (payload_t*)arg;
+    ecall_ocall_out(global_eid, (int)p->loops, p->len);
+    ecall_get_ocall_histogram(global_eid, hist);
+}
+static void run_ocall_inout(void* arg, histogram_t* hist) {
+    payload_t* p = (payload_t*)arg;
+    ecall_ocall_inout(global_eid, (int)p->loops, p->len);
+    ecall_get_ocall_histogram(global_eid, hist);
+}
+
+/* Every case is measured by the statistical engine, each trial runs
+ * `loops` calls. The histograms hold every call of the measured trials.
+ */
 void switching_benchmark(unsigned long loops, int len) {
+    static const struct { const char* name; void (*call)(void* arg); } ecalls[] = {
+        { "ecall void", call_ecall_void }, { "ecall in", call_ecall_in },
+        { "ecall out", call_ecall_out }, { "ecall inout", call_ecall_inout },
+    };
+    static const struct { const char* name; void (*run)(void* arg, histogram_t* hist); } ocalls[] = {
+        { "ocall void", run_ocall_void }, { "ocall in", run_ocall_in },
+        { "ocall out", run_ocall_out }, { "ocall inout", run_ocall_inout },
+    };
+    static histogram_t hist;
+    payload_t payload = { (long*)malloc(len * sizeof(long)), len, loops };
+    stats_result_t stats;
+    char name[64];
+
+    for (size_t i = 0; i < sizeof(ecalls) / sizeof(ecalls[0]); ++i) {
+        call_trial_t trial = { ecalls[i].call, &payload, loops, &hist };
+        hist_reset(&hist);
+        stats_measure(call_trial, &trial, &stats);
+        if (i == 0)
+            snprintf(name, sizeof(name), "[%s]", ecalls[i].name);
+        else
+            snprintf(name, sizeof(name), "[%s (long[%d])]", ecalls[i].name, len);
+        print_switching_hist(name, &hist, &stats);
+    }
+
+    for (size_t i = 0; i < sizeof(ocalls) / sizeof(ocalls[0]); ++i) {
+        hist_trial_t trial = { ocalls[i].run, &payload, &hist };
+        hist_reset(&hist);
+        stats_measure(hist_trial, &trial, &stats);
+        if (i == 0)
+            snprintf(name, sizeof(name), "[%s]", ocalls[i].name);
+        else
+            snprintf(name, sizeof(name), "[%s (long[%d])]", ocalls[i].name, len);
+        print_switching_hist(name, &hist, &stats);
+    }
+
+    free(payload.ptr);
+}
+
+double wall_time_sec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+typedef void (*switching_case_t)(unsigned long loops, long* ptr, int len);
+
+void case_ecall_void(unsigned long loops, long* ptr, int len) {
+    for (unsigned long loop = 0 ; loop < loops; loop++) ecall_void(global_eid);
+}
+void case_ecall_in(unsigned long loops, long* ptr, int len) {
+    for (unsigned long loop = 0 ; loop < loops; loop++) ecall_in(global_eid, ptr, len);
+}
+void case_ecall_out(unsigned long loops, long* ptr, int len) {
+    for (unsigned long loop = 0 ; loop < loops; loop++) ecall_out(global_eid, ptr, len);
+}
+void case_ecall_inout(unsigned long loops, long* ptr, int len) {
+    for (unsigned long loop = 0 ; loop < loops; loop++) ecall_inout(global_eid, ptr, len);
+}
+void case_ocall_void(unsigned long loops, long* ptr, int len) { ecall_ocall_void(global_eid, (int)loops); }
+void case_ocall_in(unsigned long loops, long* ptr, int len) { ecall_ocall_in(global_eid, (int)loops, len); }
+void case_ocall_out(unsigned long loops, long* ptr, int len) { ecall_ocall_out(global_eid, (int)loops, len); }
+void case_ocall_inout(unsigned long loops, long* ptr, int len) { ecall_ocall_inout(global_eid, (int)loops, len); }
+
+void case_ecall_void_switchless(unsigned long loops, long* ptr, int len) {
+    for (unsigned long loop = 0 ; loop < loops; loop++) ecall_void_switchless(global_eid);
+}
+void case_ecall_in_switchless(unsigned long loops, long* ptr, int len) {
+    for (unsigned long loop = 0 ; loop < loops; loop++) ecall_in_switchless(global_eid, ptr, len);
+}
+void case_ecall_out_switchless(unsigned long loops, long* ptr, int len) {
+    for (unsigned long loop = 0 ; loop < loops; loop++) ecall_out_switchless(global_eid, ptr, len);
+}
+void case_ecall_inout_switchless(unsigned long loops, long* ptr, int len) {
+    for (unsigned long loop = 0 ; loop < loops; loop++) ecall_inout_switchless(global_eid, ptr, len);
+}
+void case_ocall_void_switchless(unsigned long loops, long* ptr, int len) { ecall_ocall_void_switchless(global_eid, (int)loops); }
+void case_ocall_in_switchless(unsigned long loops, long* ptr, int len) { ecall_ocall_in_switchless(global_eid, (int)loops, len); }
+void case_ocall_out_switchless(unsigned long loops, long* ptr, int len) { ecall_ocall_out_switchless(global_eid, (int)loops, len); }
+void case_ocall_inout_switchless(unsigned long loops, long* ptr, int len) { ecall_ocall_inout_switchless(global_eid, (int)loops, len); }
+
+struct switching_case_desc_t {
+    const char* name;
+    bool is_ocall;
+    int copies; /* how many times the payload crosses the enclave boundary */
+    switching_case_t classic;
+    switching_case_t switchless;
+};
+
+static const switching_case_desc_t switching_cases[] = {
+    { "ecall void",  false, 0, case_ecall_void,  case_ecall_void_switchless },
+    { "ecall in",    false, 1, case_ecall_in,    case_ecall_in_switchless },
+    { "ecall out",   false, 1, case_ecall_out,   case_ecall_out_switchless },
+    { "ecall inout", false, 2, case_ecall_inout, case_ecall_inout_switchless },
+    { "ocall void",  true,  0, case_ocall_void,  case_ocall_void_switchless },
+    { "ocall in",    true,  1, case_ocall_in,    case_ocall_in_switchless },
+    { "ocall out",   true,  1, case_ocall_out,   case_ocall_out_switchless },
+    { "ocall inout", true,  2, case_ocall_inout, case_ocall_inout_switchless },
+};
+
+typedef struct _case_trial_t {
+    switching_case_t fn;
+    unsigned long loops;
+    long* ptr;
+    int len;
+} case_trial_t;
+
+static double case_trial(void* ctx, int warm) {
+    case_trial_t* t = (case_trial_t*)ctx;
+    uint64_t start_tsc = rdtsc();
+    t->fn(t->loops, t->ptr, t->len);
+    return (double)timing_since(start_tsc) / (double)t->loops;
+}
+
+/* cycles per call of fn, trials of `loops` calls */
+void measure_switching_case(switching_case_t fn, unsigned long loops, long* ptr, int len, stats_result_t* stats) {
+    case_trial_t trial = { fn, loops, ptr, len };
+    stats_measure(case_trial, &trial, stats);
+}
+
+/* every caller of the throughput run has its own payload buffer */
+typedef struct _case_callers_t {
+    switching_case_t fn;
+    std::vector<long*> ptrs;
+    int len;
+} case_callers_t;
+
+static void case_caller(void* arg, int caller, unsigned long loops) {
+    case_callers_t* c = (case_callers_t*)arg;
+    c->fn(loops, c->ptrs[caller], c->len);
+}
+
+/* Latency of one caller, then the throughput of `callers` callers at once,
+ * `loops` calls in total per trial.
+ */
+void report_switching_case(const char* mode, const switching_case_desc_t* c, switching_case_t fn,
+                           unsigned long loops, long* ptr, int len, int callers) {
+    char name[64], label[80], mean[160];
+    if (c->copies > 0)
+        snprintf(name, sizeof(name), "[%s %s (long[%d])]", mode, c->name, len);
+    else
+        snprintf(name, sizeof(name), "[%s %s]", mode, c->name);
+
+    stats_result_t stats, throughput;
+    measure_switching_case(fn, loops, ptr, len, &stats);
+
+    case_callers_t arg;
+    arg.fn = fn;
+    arg.len = len;
+    for (int t = 0; t < callers; ++t)
+        arg.ptrs.push_back((long*)malloc(len * sizeof(long)));
+    callers_trial_t trial = { case_caller, &arg, callers, loops / callers ? loops / callers : 1 };
+    stats_measure(callers_trial, &trial, &throughput);
+    for (int t = 0; t < callers; ++t)
+        free(arg.ptrs[t]);
+
+    stats_format_cycles(&stats, mean, sizeof(mean));
+    printf("%-40s switching time is %s, throughput is %.0f ± %.0f calls/s (%d callers)\n",
+            name, mean, throughput.mean, throughput.ci, callers);
+    results_add(name, "cycles", &stats);
+    snprintf(label, sizeof(label), "%.*s %d callers", (int)strlen(name) - 2, name + 1, callers);
+    results_add(label, "calls/s", &throughput);
+}
+
+/* Run every switching case through the classic EENTER/EEXIT path and through
+ * the switchless worker queues, so that both numbers are printed side by side.
+ */
+void switchless_benchmark(unsigned long loops, int len, int callers) {
     long* ptr = (long*)malloc(len * sizeof(long));
+    size_t ncases = sizeof(switching_cases) / sizeof(switching_cases[0]);
 
-    printf("start warm...\n");
-    for (unsigned long loop = 0 ; loop < loops / 10; loop++) {
-		ecall_void(global_eid);
-        ecall_in(global_eid, ptr, len);
-        ecall_out(global_eid, ptr, len);
-        ecall_inout(global_eid, ptr, len);
-	}
-    printf("warm end...\n");
-
-    uint64_t start_tsc, stop_tsc;
-	start_tsc = rdtsc();
-	for (unsigned long loop = 0 ; loop < loops; loop++) {
-		ecall_void(global_eid);
-	}
-	stop_tsc = rdtsc();
-	printf("[ecall void] switching time is %ld cycles\n", (stop_tsc - start_tsc) / loops);
-
-    start_tsc = rdtsc();
-	for (unsigned long loop = 0 ; loop < loops; loop++) {
-		ecall_in(global_eid, ptr, len);
-	}
-	stop_tsc = rdtsc();
-	printf("[ecall in (long[%d])] switching time is %ld cycles\n", len, (stop_tsc - start_tsc) / loops);
-
-    start_tsc = rdtsc();
-	for (unsigned long loop = 0 ; loop < loops; loop++) {
-		ecall_out(global_eid, ptr, len);
-	}
-	stop_tsc = rdtsc();
-	printf("[ecall out (long[%d])] switching time is %ld cycles\n", len, (stop_tsc - start_tsc) / loops);
-
-    start_tsc = rdtsc();
-	for (unsigned long loop = 0 ; loop < loops; loop++) {
-		ecall_inout(global_eid, ptr, len);
-	}
-	stop_tsc = rdtsc();
-	printf("[ecall inout (long[%d])] switching time is %ld cycles\n", len, (stop_tsc - start_tsc) / loops);
-
-    start_tsc = rdtsc();
-	ecall_ocall_void(global_eid, loops);
-	stop_tsc = rdtsc();
-	printf("[ocall void] switching time is %ld cycles\n", (stop_tsc - start_tsc) / loops);
-
-    start_tsc = rdtsc();
-	ecall_ocall_in(global_eid, loops, len);
-	stop_tsc = rdtsc();
-	printf("[ocall in (long[%d])] switching time is %ld cycles\n", len, (stop_tsc - start_tsc) / loops);
-
-    start_tsc = rdtsc();
-	ecall_ocall_out(global_eid, loops, len);
-	stop_tsc = rdtsc();
-	printf("[ocall out (long[%d])] switching time is %ld cycles\n", len, (stop_tsc - start_tsc) / loops);
-
-    start_tsc = rdtsc();
-	ecall_ocall_inout(global_eid, loops, len);
-	stop_tsc = rdtsc();
-	printf("[ocall inout (long[%d])] switching time is %ld cycles\n", len, (stop_tsc - start_tsc) / loops);
+    for (size_t i = 0; i < ncases; ++i) {
+        report_switching_case("classic", &switching_cases[i], switching_cases[i].classic, loops, ptr, len, callers);
+        report_switching_case("switchless", &switching_cases[i], switching_cases[i].switchless, loops, ptr, len,
+                              callers);
+    }
 
     free(ptr);
 }
 
+/* [in] / [out] OCALL buffers are allocated on the untrusted stack,
+ * keep OCALL payloads within half of its limit.
+ */
+long ocall_payload_limit(long max_bytes) {
+    struct rlimit stack_limit;
+    if (getrlimit(RLIMIT_STACK, &stack_limit) == 0 && stack_limit.rlim_cur != RLIM_INFINITY)
+        return (long)stack_limit.rlim_cur / 2;
+    return max_bytes;
+}
+
+/* Fit cycles = fixed + per_byte * bytes over the sweep points.
+ * Points are weighted by 1/cycles^2 (relative error), otherwise the largest
+ * payloads of a geometric sweep would decide the fixed cost alone.
+ */
+void fit_transition_cost(const long* bytes, const double* cycles, int n, double* fixed, double* per_byte) {
+    double s = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for (int i = 0; i < n; ++i) {
+        double w = 1.0 / (cycles[i] * cycles[i]);
+        double x = (double)bytes[i];
+        s += w; sx += w * x; sy += w * cycles[i]; sxx += w * x * x; sxy += w * x * cycles[i];
+    }
+    double det = s * sxx - sx * sx;
+    *per_byte = det != 0.0 ? (s * sxy - sx * sy) / det : 0.0;
+    *fixed = s != 0.0 ? (sy - *per_byte * sx) / s : 0.0;
+}
+
+/* Sweep the [in] / [out] / [in,out] ECALLs and OCALLs over payloads of 0 B
+ * and 8 B .. max_bytes in powers of two. Every trial of a size runs at most
+ * `loops` calls and at most `budget_bytes` of payload in total.
+ */
+void payload_sweep_benchmark(unsigned long loops, long max_bytes) {
+    const long budget_bytes = 256L * 1024 * 1024;
+    const unsigned long min_loops = 16;
+    const int max_points = 64;
+    long* ptr = (long*)malloc(max_bytes > 0 ? max_bytes : sizeof(long));
+    size_t ncases = sizeof(switching_cases) / sizeof(switching_cases[0]);
+
+    long ocall_max_bytes = ocall_payload_limit(max_bytes);
+
+    for (size_t c = 0; c < ncases; ++c) {
+        const switching_case_desc_t* desc = &switching_cases[c];
+        if (desc->copies == 0)
+            continue;
+
+        long bytes[max_points];
+        double cycles[max_points];
+        int npoints = 0;
+
+        for (long size = 0; size <= max_bytes && npoints < max_points; size = size ? size * 2 : 8) {
+            if (desc->is_ocall && size > ocall_max_bytes) {
+                printf("Info: [%s] skip %ld bytes and above, untrusted stack limit is %ld bytes\n",
+                        desc->name, size, ocall_max_bytes * 2);
+                break;
+            }
+            int len = (int)(size / sizeof(long));
+            unsigned long n = size ? (unsigned long)(budget_bytes / size) : loops;
+            if (n > loops) n = loops;
+            if (n < min_loops) n = min_loops;
+
+            stats_result_t stats;
+            char name[64], mean[160];
+            measure_switching_case(desc->classic, n, ptr, len, &stats);
+            stats_format_cycles(&stats, mean, sizeof(mean));
+
+            double call_cycles = stats.mean;
+            double moved = (double)size * desc->copies;
+            printf("%-30s [ %ld bytes, loops: %lu]    time is %s, bandwidth is %.3f GB/s\n",
+                    desc->name, size, n, mean, moved / timing_ns(call_cycles));
+            snprintf(name, sizeof(name), "%s %ld bytes", desc->name, size);
+            results_add(name, "cycles", &stats);
+
+            bytes[npoints] = size;
+            cycles[npoints] = call_cycles;
+            npoints++;
+        }
+
+        double fixed, per_byte;
+        char name[64];
+        fit_transition_cost(bytes, cycles, npoints, &fixed, &per_byte);
+        printf("%-30s fixed cost is %.0f cycles (%.1f ns), copy cost is %.4f cycles/byte, crossover at %.0f bytes\n",
+                desc->name, fixed, timing_ns(fixed), per_byte, per_byte > 0 ? fixed / per_byte : 0.0);
+        snprintf(name, sizeof(name), "%s fixed cost", desc->name);
+        results_add_value(name, "cycles", fixed);
+        snprintf(name, sizeof(name), "%s copy cost", desc->name);
+        results_add_value(name, "cycles/byte", per_byte);
+    }
+
+    free(ptr);
+}
+
+void case_ecall_in_read(unsigned long loops, long* ptr, int len) {
+    for (unsigned long loop = 0 ; loop < loops; loop++) ecall_in_read(global_eid, ptr, len);
+}
+void case_ecall_user_check_read(unsigned long loops, long* ptr, int len) {
+    for (unsigned long loop = 0 ; loop < loops; loop++) ecall_user_check_read(global_eid, ptr, len);
+}
+void case_ecall_out_write(unsigned long loops, long* ptr, int len) {
+    for (unsigned long loop = 0 ; loop < loops; loop++) ecall_out_write(global_eid, ptr, len);
+}
+void case_ecall_user_check_write(unsigned long loops, long* ptr, int len) {
+    for (unsigned long loop = 0 ; loop < loops; loop++) ecall_user_check_write(global_eid, ptr, len);
+}
+void case_ocall_in_read(unsigned long loops, long* ptr, int len) { ecall_ocall_in_read(global_eid, (int)loops, len); }
+void case_ocall_user_check_read(unsigned long loops, long* ptr, int len) { ecall_ocall_user_check_read(global_eid, (int)loops, ptr, len); }
+void case_ocall_out_write(unsigned long loops, long* ptr, int len) { ecall_ocall_out_write(global_eid, (int)loops, len); }
+void case_ocall_user_check_write(unsigned long loops, long* ptr, int len) { ecall_ocall_user_check_write(global_eid, (int)loops, ptr, len); }
+
+struct user_check_case_desc_t {
+    const char* name;
+    bool is_ocall;
+    switching_case_t copy;
+    switching_case_t user_check;
+};
+
+/* read: the callee reads the whole payload, write: the callee fills it */
+static const user_check_case_desc_t user_check_cases[] = {
+    { "ecall read",  false, case_ecall_in_read,   case_ecall_user_check_read },
+    { "ecall write", false, case_ecall_out_write, case_ecall_user_check_write },
+    { "ocall read",  true,  case_ocall_in_read,   case_ocall_user_check_read },
+    { "ocall write", true,  case_ocall_out_write, case_ocall_user_check_write },
+};
+
+/* Compare copy-marshaled ([in] / [out]) payloads with zero-copy [user_check]
+ * payloads for sizes 8 B .. max_bytes (x4 steps). Both sides include the
+ * transition and one full pass of the callee over the payload.
+ */
+void user_check_benchmark(unsigned long loops, long max_bytes) {
+    const long budget_bytes = 256L * 1024 * 1024;
+    const unsigned long min_loops = 16;
+    long* ptr = (long*)malloc(max_bytes > 0 ? max_bytes : sizeof(long));
+    size_t ncases = sizeof(user_check_cases) / sizeof(user_check_cases[0]);
+
+    long ocall_max_bytes = ocall_payload_limit(max_bytes);
+
+    for (size_t c = 0; c < ncases; ++c) {
+        const user_check_case_desc_t* desc = &user_check_cases[c];
+        for (long size = 8; size <= max_bytes; size *= 4) {
+            if (desc->is_ocall && size > ocall_max_bytes) {
+                printf("Info: [%s] skip %ld bytes and above, untrusted stack limit is %ld bytes\n",
+                        desc->name, size, ocall_max_bytes * 2);
+                break;
+            }
+            int len = (int)(size / sizeof(long));
+            unsigned long n = (unsigned long)(budget_bytes / size);
+            if (n > loops) n = loops;
+            if (n < min_loops) n = min_loops;
+
+            stats_result_t copy, user_check;
+            char name[64], copy_mean[160], user_check_mean[160];
+            measure_switching_case(desc->copy, n, ptr, len, &copy);
+            measure_switching_case(desc->user_check, n, ptr, len, &user_check);
+            stats_format_cycles(&copy, copy_mean, sizeof(copy_mean));
+            stats_format_cycles(&user_check, user_check_mean, sizeof(user_check_mean));
+            printf("%-30s [ %ld bytes, loops: %lu]    copy time is %s, user_check time is %s, saving %.1f%%\n",
+                    desc->name, size, n, copy_mean, user_check_mean,
+                    100.0 * (copy.mean - user_check.mean) / copy.mean);
+            snprintf(name, sizeof(name), "%s copy %ld bytes", desc->name, size);
+            results_add(name, "cycles", &copy);
+            snprintf(name, sizeof(name), "%s user_check %ld bytes", desc->name, size);
+            results_add(name, "cycles", &user_check);
+        }
+    }
+
+    free(ptr);
+}
+
+/* Host memory of the baselines: 4 KB pages (THP off), transparent huge pages
+ * (madvise) or 2 MB hugetlbfs pages. NULL when the kind is not available,
+ * e.g. no huge pages reserved in /proc/sys/vm/nr_hugepages or THP [never].
+ */
+#define HOST_PAGES_4K      0
+#define HOST_PAGES_THP     1
+#define HOST_PAGES_HUGETLB 2
+#define HOST_PAGE_KINDS    3
+#define HUGE_PAGE_SIZE     (2L * 1024 * 1024)
+
+static const char* host_page_kinds[HOST_PAGE_KINDS] = { "4k", "thp", "hugetlb" };
+
+/* THP is off when the mode is [never]; madvise still succeeds then */
+static int host_thp_enabled(void) {
+    char mode[128] = "";
+    FILE* fp = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+    if (fp == NULL)
+        return 0;
+    if (fgets(mode, sizeof(mode), fp) == NULL)
+        mode[0] = '\0';
+    fclose(fp);
+    return mode[0] != '\0' && strstr(mode, "[never]") == NULL;
+}
+
+static void* host_map(long size, int kind) {
+    void* p;
+    if (kind == HOST_PAGES_HUGETLB) {
+        if (size % HUGE_PAGE_SIZE != 0)
+            return NULL;
+        p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        return p == MAP_FAILED ? NULL : p;
+    }
+    if (kind == HOST_PAGES_4K) {
+        p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED)
+            return NULL;
+        madvise(p, size, MADV_NOHUGEPAGE);
+        return p;
+    }
+    if (!host_thp_enabled())
+        return NULL;
+    /* THP needs 2 MB aligned ranges */
+    char* raw = (char*)mmap(NULL, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED)
+        return NULL;
+    char* aligned = (char*)(((uintptr_t)raw + HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(HUGE_PAGE_SIZE - 1));
+    if (aligned > raw)
+        munmap(raw, aligned - raw);
+    munmap(aligned + size, raw + HUGE_PAGE_SIZE - aligned);
+    if (madvise(aligned, size, MADV_HUGEPAGE) != 0) {
+        munmap(aligned, size);
+        return NULL;
+    }
+    return aligned;
+}
+
+/* per-iteration latencies of one memory management phase */
+static histogram_t mm_hist;
+
+void print_mm_hist(const char* name, int page_num, int num, const histogram_t* hist) {
+    char percentiles[256];
+    hist_format(hist, percentiles, sizeof(percentiles));
+    printf("%-30s [ %d pages, num: %d]    time is %ld ± %.0f cycles (%.1f ns), per page %.0f cycles, n=%lu, %s\n",
+            name, page_num, num, hist_mean(hist), hist_ci95(hist), timing_ns(hist_mean(hist)),
+            (double)hist_mean(hist) / page_num, (unsigned long)hist->count, percentiles);
+    results_add_hist(name, "cycles/page", hist, (double)page_num);
+}
+
+/* Write one byte of every page of the block */
+static void touch_pages(char* p, int size) {
+    for (char* ch_ptr = p; ch_ptr < p + size; ch_ptr += 4096) *(volatile char*)ch_ptr = 'a';
+}
+
+/* First touch of num blocks of huge pages, mapped and unmapped untimed */
+static void host_first_touch(int kind, int page_num, int num) {
+    long size = (long)page_num * 4096;
+    void** pp = (void**)calloc(num, sizeof(void*));
+    char name[64];
+
+    hist_reset(&mm_hist);
+    for (int i = 0; i < num; ++i) {
+        pp[i] = host_map(size, kind);
+        if (pp[i] == NULL) {
+            printf("Info: no %s pages for the baseline\n", host_page_kinds[kind]);
+            hist_reset(&mm_hist);
+            break;
+        }
+        uint64_t start_tsc = rdtsc();
+        touch_pages((char*)pp[i], (int)size);
+        hist_record(&mm_hist, timing_since(start_tsc));
+    }
+    for (int i = 0; i < num && pp[i] != NULL; ++i) munmap(pp[i], size);
+    free(pp);
+    if (mm_hist.count == 0)
+        return;
+    snprintf(name, sizeof(name), "[Linux mmap %s first touch]", host_page_kinds[kind]);
+    print_mm_hist(name, page_num, num, &mm_hist);
+}
+
 void memory_management_benchmark(int page_num, int num) {
-	uint64_t start_tsc, stop_tsc;
+	uint64_t start_tsc;
     int ret;
     void** pp = (void**)malloc(sizeof(void*) * num);
     int size = page_num * 4096;
     void* err_ret = (void *)(~(size_t)0);
+    char* heap_block;
 
-    start_tsc = rdtsc();
+    hist_reset(&mm_hist);
     for (int i = 0; i < num; ++i) {
+        start_tsc = rdtsc();
         pp[i] = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        uint64_t cycles = timing_since(start_tsc);
         if (pp[i] == MAP_FAILED) { 
             perror("mmap error\n");
             goto out;
         }
-        for (char* ch_ptr = (char*)pp[i]; ch_ptr < (char*)pp[i] + size; ch_ptr += 4096) *ch_ptr = 'a';
+        madvise(pp[i], size, MADV_NOHUGEPAGE);
+        hist_record(&mm_hist, cycles);
     }
-    stop_tsc = rdtsc();
-    printf("%-30s [ %d pages, num: %d]    time is %ld\n", "[Linux mmap]", page_num, num, (stop_tsc - start_tsc) / num);
+    print_mm_hist("[Linux mmap]", page_num, num, &mm_hist);
 
-    start_tsc = rdtsc();
+    hist_reset(&mm_hist);
     for (int i = 0; i < num; ++i) {
+        start_tsc = rdtsc();
+        touch_pages((char*)pp[i], size);
+        hist_record(&mm_hist, timing_since(start_tsc));
+    }
+    print_mm_hist("[Linux mmap first touch]", page_num, num, &mm_hist);
+
+    hist_reset(&mm_hist);
+    for (int i = 0; i < num; ++i) {
+        start_tsc = rdtsc();
+        touch_pages((char*)pp[i], size);
+        hist_record(&mm_hist, timing_since(start_tsc));
+    }
+    print_mm_hist("[Linux mmap re-touch]", page_num, num, &mm_hist);
+
+    hist_reset(&mm_hist);
+    for (int i = 0; i < num; ++i) {
+        start_tsc = rdtsc();
         ret = mprotect(pp[i], size, PROT_READ | PROT_WRITE | PROT_EXEC);
         if (ret != 0) {
             perror("mprotect extend error\n");
             goto out;
         }
+        hist_record(&mm_hist, timing_since(start_tsc));
     }
-    stop_tsc = rdtsc();
-    printf("%-30s [ %d pages, num: %d]    time is %ld\n", "[Linux mprotect extend]", page_num, num, (stop_tsc - start_tsc) / num);
+    print_mm_hist("[Linux mprotect extend]", page_num, num, &mm_hist);
 
-    start_tsc = rdtsc();
+    hist_reset(&mm_hist);
     for (int i = 0; i < num; ++i) {
+        start_tsc = rdtsc();
         ret = mprotect(pp[i], size, PROT_READ);
         if (ret != 0) {
             perror("mprotect restrict error\n");
             goto out;
         }
+        hist_record(&mm_hist, timing_since(start_tsc));
     }
-    stop_tsc = rdtsc();
-    printf("%-30s [ %d pages, num: %d]    time is %ld\n", "[Linux mprotect restrict]", page_num, num, (stop_tsc - start_tsc) / num);
+    print_mm_hist("[Linux mprotect restrict]", page_num, num, &mm_hist);
 
-    start_tsc = rdtsc();
+    hist_reset(&mm_hist);
     for (int i = 0; i < num; ++i) {
+        start_tsc = rdtsc();
         ret = munmap(pp[i], size);
         if (ret != 0) {
             perror("munmap error\n");
             goto out;
         }
+        hist_record(&mm_hist, timing_since(start_tsc));
     }
-    stop_tsc = rdtsc();
-    printf("%-30s [ %d pages, num: %d]    time is %ld\n", "[Linux munmap]", page_num, num, (stop_tsc - start_tsc) / num);
+    print_mm_hist("[Linux munmap]", page_num, num, &mm_hist);
 
-    start_tsc = rdtsc();
+    /* the kernel faults every page in inside mmap */
+    hist_reset(&mm_hist);
     for (int i = 0; i < num; ++i) {
+        start_tsc = rdtsc();
+        pp[i] = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+        uint64_t cycles = timing_since(start_tsc);
+        if (pp[i] == MAP_FAILED) {
+            perror("mmap populate error\n");
+            for (int j = 0; j < i; ++j) munmap(pp[j], size);
+            goto out;
+        }
+        hist_record(&mm_hist, cycles);
+    }
+    for (int i = 0; i < num; ++i) munmap(pp[i], size);
+    print_mm_hist("[Linux mmap populate]", page_num, num, &mm_hist);
+
+    if (size % HUGE_PAGE_SIZE == 0) {
+        host_first_touch(HOST_PAGES_THP, page_num, num);
+        host_first_touch(HOST_PAGES_HUGETLB, page_num, num);
+    }
+
+    heap_block = (char*)sbrk(0);
+    hist_reset(&mm_hist);
+    for (int i = 0; i < num; ++i) {
+        start_tsc = rdtsc();
         void* p = sbrk(size);
+        uint64_t cycles = timing_since(start_tsc);
         if (p == err_ret) {
             perror("linux sbrk extend error\n");
             goto out;
         }
-        for (char* ch_ptr = (char*)p; ch_ptr < (char*)p + size; ch_ptr += 4096) *ch_ptr = 'a';
+        hist_record(&mm_hist, cycles);
+    }
+    print_mm_hist("[Linux sbrk extend]", page_num, num, &mm_hist);
+
+    hist_reset(&mm_hist);
+    for (int i = 0; i < num; ++i) {
+        start_tsc = rdtsc();
+        touch_pages(heap_block + (long)i * size, size);
+        hist_record(&mm_hist, timing_since(start_tsc));
     }
-    stop_tsc = rdtsc();
-    printf("%-30s [ %d pages, num: %d]    time is %ld\n", "[Linux sbrk extend]", page_num, num, (stop_tsc - start_tsc) / num);
+    print_mm_hist("[Linux sbrk first touch]", page_num, num, &mm_hist);
     
-    start_tsc = rdtsc();
+    hist_reset(&mm_hist);
     for (int i = 0; i < num; ++i) {
+        start_tsc = rdtsc();
         void* p = sbrk(-size);
         if (p == err_ret) {
             perror("linux sbrk extend error\n");
             goto out;
         }
+        hist_record(&mm_hist, timing_since(start_tsc));
     }
-    stop_tsc = rdtsc();
-    printf("%-30s [ %d pages, num: %d]    time is %ld\n", "[Linux sbrk shrink]", page_num, num, (stop_tsc - start_tsc) / num);
+    print_mm_hist("[Linux sbrk shrink]", page_num, num, &mm_hist);
 
 out:
     free(pp);
@@ -341,57 +949,156 @@ out:
     ecall_memory_management_benchmark(global_eid, page_num, num);
 }
 
+/* One pass of an access pattern over the prepared trusted or untrusted
+ * buffer, the figure is the cycles of the pass.
+ */
+typedef struct _mem_access_trial_t {
+    int trusted;
+    int random;
+    long bytes;
+    int block_size;
+} mem_access_trial_t;
+
+static double mem_access_trial(void* ctx, int warm)
+{
+    mem_access_trial_t* t = (mem_access_trial_t*)ctx;
+    uint64_t start_tsc = rdtsc();
+    if (t->trusted && t->random)
+        ecall_rand_t_memory_access_benchmark(global_eid, t->bytes, t->block_size);
+    else if (t->trusted)
+        ecall_seq_t_memory_access_benchmark(global_eid, t->bytes, t->block_size);
+    else if (t->random)
+        ecall_rand_u_memory_access_benchmark(global_eid, t->bytes, t->block_size);
+    else
+        ecall_seq_u_memory_access_benchmark(global_eid, t->bytes, t->block_size);
+    return (double)timing_since(start_tsc);
+}
+
+/* Every memory size runs against three host baselines, see host_map, so
+ * the normalized sgx / linux ratio can be split into 4 KB page (TLB) cost
+ * and encryption. All buffers are pre-faulted by the prepare ECALLs. Each
+ * pass is measured with stats_measure, the ratios carry the CI of both.
+ */
 void memory_access_benchmark(int block_size) {
     const long MB_SIZE = 1024 * 1024;
     const long BYTES_NEED_ACCESS = MB_SIZE * 1024 * 4;
     const long mem_mb_sizes[6] = {4, 16, 64, 256, 1024, 4096};
+    static const char* patterns[2] = { "seq", "random" };
     for (int idx = 0; idx < 6; ++idx) {
         long mem_size = mem_mb_sizes[idx] * MB_SIZE;
+        stats_result_t host[HOST_PAGE_KINDS][2], sgx[2];
+        int have[HOST_PAGE_KINDS] = {0};
+        mem_access_trial_t trial = { 0, 0, BYTES_NEED_ACCESS, block_size };
+        char name[64], mean[160];
 
-        void* mem = memalign(4096, mem_size);
-        assert(mem != NULL);
-        ecall_prepare_u_memory_access_benchmark(global_eid, mem_size, (long)mem);
+        for (int kind = 0; kind < HOST_PAGE_KINDS; ++kind) {
+            void* mem = host_map(mem_size, kind);
+            if (mem == NULL) {
+                assert(kind != HOST_PAGES_4K);
+                if (idx == 0)
+                    printf("Info: no %s pages, no %s baseline\n", host_page_kinds[kind], host_page_kinds[kind]);
+                continue;
+            }
+            ecall_prepare_u_memory_access_benchmark(global_eid, mem_size, (long)mem);
+            for (trial.random = 0; trial.random < 2; ++trial.random)
+                stats_measure(mem_access_trial, &trial, &host[kind][trial.random]);
+            have[kind] = 1;
+            munmap(mem, mem_size);
+        }
 
-        uint64_t start_tsc, end_tsc;
-        start_tsc = rdtsc();
-        ecall_seq_u_memory_access_benchmark(global_eid, BYTES_NEED_ACCESS, block_size);
-        end_tsc = rdtsc();
-        uint64_t seq_time = end_tsc - start_tsc;
+        ecall_prepare_t_memory_access_benchmark(global_eid, mem_size);
+        trial.trusted = 1;
+        for (trial.random = 0; trial.random < 2; ++trial.random)
+            stats_measure(mem_access_trial, &trial, &sgx[trial.random]);
 
-        start_tsc = rdtsc();
-        ecall_rand_u_memory_access_benchmark(global_eid, BYTES_NEED_ACCESS, block_size);
-        end_tsc = rdtsc();
-        uint64_t rand_time = end_tsc - start_tsc;
+        for (int r = 0; r < 2; ++r) {
+            stats_format_cycles(&sgx[r], mean, sizeof(mean));
+            printf("%-30s [ mem_size: %ld MB, total_access_size: %ld MB, block_size: %d bytes]    %s access time is %s\n",
+                "[sgx]", mem_mb_sizes[idx], BYTES_NEED_ACCESS / MB_SIZE, block_size, patterns[r], mean);
+            snprintf(name, sizeof(name), "%s sgx %ld MB", patterns[r], mem_mb_sizes[idx]);
+            results_add(name, "cycles", &sgx[r]);
+        }
+        for (int kind = 0; kind < HOST_PAGE_KINDS; ++kind) {
+            if (!have[kind])
+                continue;
+            for (int r = 0; r < 2; ++r) {
+                stats_result_t ratio;
+                char label[64];
+                stats_ratio(&sgx[r], &host[kind][r], &ratio);
+                stats_format_cycles(&host[kind][r], mean, sizeof(mean));
+                snprintf(label, sizeof(label), "[linux %s]", host_page_kinds[kind]);
+                printf("%-30s [ mem_size: %ld MB, total_access_size: %ld MB, block_size: %d bytes]    %s access time is %s, sgx / linux = %.3f ± %.3f\n",
+                    label, mem_mb_sizes[idx], BYTES_NEED_ACCESS / MB_SIZE, block_size, patterns[r], mean,
+                    ratio.mean, ratio.ci);
 
-        free(mem);
+                /* pattern, host baseline page kind (4k, thp or hugetlb) and buffer size */
+                snprintf(name, sizeof(name), "%s linux %s %ld MB", patterns[r], host_page_kinds[kind], mem_mb_sizes[idx]);
+                results_add(name, "cycles", &host[kind][r]);
+                snprintf(name, sizeof(name), "%s sgx / linux %s %ld MB", patterns[r], host_page_kinds[kind], mem_mb_sizes[idx]);
+                results_add(name, "ratio", &ratio);
+            }
+        }
+    }
+}
 
+typedef struct _create_enclave_arg_t {
+    const char* config;
+    int loops;
+    int failed;      /* a load failed, later trials do nothing */
+} create_enclave_arg_t;
 
-        ecall_prepare_t_memory_access_benchmark(global_eid, mem_size);
+static double create_enclave_trial(void* ctx, int warm)
+{
+    create_enclave_arg_t* arg = (create_enclave_arg_t*)ctx;
+    int loops = arg->loops;
+    uint64_t time = 0;
+    if (arg->failed)
+        return 0.0;
+    for (int i = 0; i < loops; ++i) {
+        uint64_t start_tsc = rdtsc();
+        if (initialize_enclave(arg->config) < 0) {
+            arg->failed = 1;
+            return 0.0;
+        }
+        time += timing_since(start_tsc);
 
-        start_tsc = rdtsc();
-        ecall_seq_t_memory_access_benchmark(global_eid, BYTES_NEED_ACCESS, block_size);
-        end_tsc = rdtsc();
-        uint64_t sgx_seq_time = end_tsc - start_tsc;
+        sgx_destroy_enclave(global_eid);
+    }
+    return (double)time / loops;
+}
 
-        start_tsc = rdtsc();
-        ecall_rand_t_memory_access_benchmark(global_eid, BYTES_NEED_ACCESS, block_size);
-        end_tsc = rdtsc();
-        uint64_t sgx_rand_time = end_tsc - start_tsc;
-
-        printf("%-30s [ mem_size: %ld MB, total_access_size: %ld MB, block_size: %d bytes]    seq access time is %ld / %ld = %f, random access time is %ld / %ld = %f\n", 
-            "[sgx / linux / normalized]", mem_mb_sizes[idx], BYTES_NEED_ACCESS / MB_SIZE, block_size, 
-            sgx_seq_time, seq_time, (double)sgx_seq_time / (double)seq_time, 
-            sgx_rand_time, rand_time, (double)sgx_rand_time / (double)rand_time);
+/* create_enclave_benchmark:
+ *   Time to load the enclave signed with config, trials of 'loops' loads.
+ */
+int create_enclave_benchmark(const char* config, int loops)
+{
+    create_enclave_arg_t arg = { config, loops, 0 };
+    stats_result_t stats;
+    char mean[160];
+
+    stats_measure(create_enclave_trial, &arg, &stats);
+    if (arg.failed) {
+        printf("Error: initialize_enclave failed\n");
+        return -1;
     }
+    stats_format_cycles(&stats, mean, sizeof(mean));
+    printf("[create_enclave] time is %s\n", mean);
+    results_add("create_enclave", "cycles", &stats);
+    return 0;
 }
 
 /* Application entry */
 int SGX_CDECL main(int argc, char *argv[])
 {
     if (argc < 3) {
-        printf("[cmd]: ./bench [affinity] [bench type]\n"
+        printf("[cmd]: ./bench [affinity] [bench type] [params...]\n"
+                "       ./bench [affinity] list\n"
+                "       ./bench [affinity] run [--repeat N] [--set name=value] [--sweep name=a,b,c|lo..hi] [--config a,b] [--output FILE]\n"
+                "                              [--ci PCT] [--budget SEC] [--min-trials N] [--max-trials N] [--max-warmup N] [filter...]\n"
+                "       ./bench [affinity] sweep [--cpus a,b] [--output FILE] [--resume] [--drift PCT] [--max-cooldown SEC] [plan...]\n"
+                "       ./bench [affinity] compare BASE CURRENT [--threshold PCT]\n"
                 "affinity: specify one cpu number, e.g. 0. (-1 means no affinity)\n"
-                "bench type: switching / memory_management / memory_access / create_enclave\n");
+                "bench type: see list, it prints every benchmark with its parameters and defaults\n");
         return -1;
     }
 
@@ -404,71 +1111,10 @@ int SGX_CDECL main(int argc, char *argv[])
 	    printf("Info: setaffinity %d, now cpu is at %d\n", cpu, sched_getcpu());
     }
 
-    if (strcmp(argv[2], "switching") == 0) {
-        if (initialize_enclave() < 0) {
-            printf("Error: initialize_enclave failed\n");
-            return -1;
-        }
-
-        switching_benchmark(1000000, 128);
-
-        sgx_destroy_enclave(global_eid);
-    }
-    else if (strcmp(argv[2], "memory_management") == 0) {
-        if (argc < 5) {
-            printf("Error: you should specify page_num (# of pages) and loop_num\n"); 
-            return -1;
-        }
-        int page_num = atoi(argv[3]);
-        int num = atoi(argv[4]);
-
-        if (initialize_enclave() < 0) {
-            printf("Error: initialize_enclave failed\n");
-            return -1;
-        }
-
-        memory_management_benchmark(page_num, num);
-
-        sgx_destroy_enclave(global_eid);
-    }
-    else if (strcmp(argv[2], "memory_access") == 0) {
-        if (argc < 4) {
-            printf("Error: you should specify block_size (1, 4, 8, 16, 32 or 64)\n"); 
-            return -1;
-        }
-        int block_size = atoi(argv[3]);
-
-        if (initialize_enclave() < 0) {
-            printf("Error: initialize_enclave failed\n");
-            return -1;
-        }
-
-        memory_access_benchmark(block_size);
-
-        sgx_destroy_enclave(global_eid);
-    }
-    else if (strcmp(argv[2], "create_enclave") == 0) {
-        int loops = 10;
-        uint64_t time = 0;
-        for (int i = 0; i < loops; ++i) {
-            uint64_t start_tsc = rdtsc();
-            if (initialize_enclave() < 0) {
-                printf("Error: initialize_enclave failed\n");
-                return -1;
-            }
-            uint64_t end_tsc = rdtsc();
-            time += end_tsc - start_tsc;
-
-            sgx_destroy_enclave(global_eid);
-        }
-        printf("[create_enclave] time is %ld cycles\n", time / loops);
-    }
-    else {
-        printf("Error: bench type should be 'switching' or 'memory_management' or 'memory_access' or 'create_enclave'!\n"); 
-    }
+    timing_init();
 
+    int ret = bench_main(argc - 2, argv + 2);
 
     printf("Info: sgx_benchmark exited.\n");
-    return 0;
+    return ret;
 }
-
@@ -37,9 +37,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <stdint.h>
 
 #include "sgx_error.h"       /* sgx_status_t */
 #include "sgx_eid.h"     /* sgx_enclave_id_t */
+#include "timing.h"
+#include "histogram.h"
 
 #ifndef TRUE
 # define TRUE 1
@@ -50,7 +53,7 @@
 #endif
 
 # define TOKEN_FILENAME   "enclave.token"
-# define ENCLAVE_FILENAME "enclave.signed.so"
+# define ENCLAVE_IMAGE_FORMAT "enclave.%s.signed.so" /* one per config, see the Makefile */
 
 extern sgx_enclave_id_t global_eid;    /* global enclave id */
 
@@ -67,8 +70,115 @@ void ecall_libc_functions(void);
 void ecall_libcxx_functions(void);
 void ecall_thread_functions(void);
 
+void timing_init(void);
+double wall_time_sec(void);
+
+/* One trial of a measurement, returns its figure (e.g. cycles per call).
+ * warm is 1 for warm-up trials, whose results are thrown away.
+ */
+typedef double (*stats_trial_t)(void* ctx, int warm);
+
+typedef struct _stats_config_t {
+    int min_trials;
+    int max_trials;
+    double ci_target;        /* CI half-width relative to the mean */
+    double budget_sec;       /* per measurement, warm-up included */
+    int max_warmup;
+    double warmup_tolerance; /* relative */
+} stats_config_t;
+
+typedef struct _stats_result_t {
+    double mean;
+    double ci;       /* half-width of the 95% confidence interval */
+    double stddev;
+    int trials;      /* after outlier rejection */
+    int outliers;
+    int warmup;
+    int converged;   /* ci target met */
+} stats_result_t;
+
+extern stats_config_t stats_config;
+void stats_measure(stats_trial_t trial, void* ctx, stats_result_t* r);
+int stats_format_cycles(const stats_result_t* r, char* buf, size_t len);
+void stats_ratio(const stats_result_t* num, const stats_result_t* den, stats_result_t* r);
+double stats_t95(int df);
+
+typedef struct _call_trial_t {
+    void (*call)(void* arg);
+    void* arg;
+    unsigned long loops;
+    histogram_t* hist;
+} call_trial_t;
+double call_trial(void* ctx, int warm);
+
+typedef struct _hist_trial_t {
+    void (*run)(void* arg, histogram_t* hist);
+    void* arg;
+    histogram_t* hist;
+} hist_trial_t;
+double hist_trial(void* ctx, int warm);
+
+typedef struct _callers_trial_t {
+    void (*run)(void* arg, int caller, unsigned long loops);
+    void* arg;
+    int callers;
+    unsigned long loops;   /* per caller */
+} callers_trial_t;
+double callers_trial(void* ctx, int warm);
+
+int results_open(const char* path, int append);
+void results_close(void);
+void results_defer(int on);
+void results_commit(void);
+void results_begin(const char* bench, const char* config, const char* params);
+void results_add(const char* name, const char* unit, const stats_result_t* stats);
+void results_add_hist(const char* name, const char* unit, const histogram_t* hist, double scale);
+void results_add_value(const char* name, const char* unit, double value);
+int results_compare(int argc, char* argv[]);
+
+void print_switching_hist(const char* name, const histogram_t* hist, const stats_result_t* stats);
+
+int initialize_enclave(const char* config);
+int initialize_switchless_enclave(const char* config, unsigned int num_uworkers, unsigned int num_tworkers);
+int bench_main(int argc, char* argv[]);
+int bench_run_with(const char* name, int nset, const char* set[]);
+int bench_enclave_reset(void);
+void bench_enclave_release(void);
+int sweep_main(int argc, char* argv[]);
+
+void switching_benchmark(unsigned long loops, int len);
+void switchless_benchmark(unsigned long loops, int len, int callers);
+void payload_sweep_benchmark(unsigned long loops, long max_bytes);
+void user_check_benchmark(unsigned long loops, long max_bytes);
+void memory_management_benchmark(int page_num, int num);
+void memory_access_benchmark(int block_size);
+int create_enclave_benchmark(const char* config, int loops);
+
+void ecall_scaling_benchmark(int max_threads, const char* cpu_list, unsigned long loops, int len);
+void nested_benchmark(unsigned long loops, int max_depth, int len);
+void batch_benchmark(unsigned long total_ops, int max_batch);
+
+struct rpc_engine_t;
+rpc_engine_t* rpc_engine_start(int nworkers, int policy, uint64_t capacity, uint64_t payload_size);
+void rpc_engine_stop(rpc_engine_t* e);
+int rpc_policy_from_name(const char* name);
+void rpc_benchmark(unsigned long loops, int nworkers, int policy, int len, int callers);
+void async_benchmark(int steps, int nworkers, int ntasks, uint64_t io_cycles);
+
+void alloc_benchmark(long min_size, long max_size, int max_threads, const char* cpu_list, int objects, int rounds);
+void malloc_benchmark(long min_size, long max_size, long realloc_max, int max_threads, const char* cpu_list, long ops);
+void epc_benchmark(long accesses, long max_mb, double factor);
+void edmm_scaling_benchmark(int page_num, int iterations, int max_threads, int nbusy, const char* cpu_list);
+int heap_growth_benchmark(const char* config, const char* sizes, long total_mb);
+int stack_growth_benchmark(const char* config, const char* depths, int pool, long min_kb);
+int tcs_create_benchmark(const char* config, const char* bursts, int pool, int rounds);
+int stream_benchmark(long array_mb, int passes, const char* isa);
+
 #if defined(__cplusplus)
 }
+
+#include <vector>
+std::vector<int> parse_cpu_list(const char* list);
 #endif
 
 #endif /* !_APP_H_ */
@@ -0,0 +1,179 @@
+/* Alloc.cpp - in-enclave allocator benchmark.
+ *
+ * The slab allocator (Enclave/Benchmark/Slab.cpp), tlibc malloc and plain
+ * sbrk run the workload of alloc_bench.h for object sizes min_size ..
+ * max_size (doubling) and 1, 2, 4, ... max_threads threads. Reported are the
+ * alloc + free throughput of all threads, the cycles of one alloc and one
+ * free, and the fragmentation: heap or arena footprint over the bytes live
+ * at the peak. sbrk never frees, its throughput counts allocations only and
+ * it has no free figure. The enclave needs one TCS per thread.
+ */
+
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../App.h"
+#include "Enclave_u.h"
+#include "alloc_bench.h"
+
+static const char* alloc_kinds[ALLOC_KIND_COUNT] = { "slab", "malloc", "sbrk" };
+
+struct alloc_thread_ctx_t {
+    int cpu;               /* -1 means no affinity */
+    int thread;
+    int ret;
+    alloc_bench_stats_t stats;
+};
+
+struct alloc_step_t {
+    int kind;
+    size_t size;
+    int rounds;
+    std::vector<alloc_thread_ctx_t> ctxs;
+    int errors;
+};
+
+static std::atomic<int> alloc_ready(0);
+static std::atomic<bool> alloc_go(false);
+
+static void alloc_thread(alloc_step_t* step, alloc_thread_ctx_t* ctx)
+{
+    if (ctx->cpu >= 0) {
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        CPU_SET(ctx->cpu, &mask);
+        sched_setaffinity(0, sizeof(mask), &mask);
+    }
+
+    alloc_ready++;
+    while (!alloc_go.load())
+        __builtin_ia32_pause();
+
+    if (ecall_alloc_run(global_eid, &ctx->ret, step->kind, ctx->thread, step->size, step->rounds,
+                        &ctx->stats) != SGX_SUCCESS)
+        ctx->ret = -1;
+}
+
+/* One trial: every thread runs its rounds, returns alloc + free ops/s */
+static double alloc_trial(void* arg, int warm)
+{
+    alloc_step_t* step = (alloc_step_t*)arg;
+    int nthreads = (int)step->ctxs.size();
+    std::vector<std::thread> threads;
+
+    alloc_ready = 0;
+    alloc_go = false;
+    for (int t = 0; t < nthreads; ++t)
+        threads.push_back(std::thread(alloc_thread, step, &step->ctxs[t]));
+
+    while (alloc_ready.load() < nthreads)
+        __builtin_ia32_pause();
+    double start_sec = wall_time_sec();
+    alloc_go = true;
+    for (int t = 0; t < nthreads; ++t)
+        threads[t].join();
+    double stop_sec = wall_time_sec();
+    ecall_alloc_finish(global_eid, step->kind, 0);
+
+    uint64_t ops = 0;
+    for (int t = 0; t < nthreads; ++t) {
+        if (step->ctxs[t].ret != 0)
+            step->errors++;
+        ops += step->ctxs[t].stats.alloc_ops + step->ctxs[t].stats.free_ops;
+    }
+    return (double)ops / (stop_sec - start_sec);
+}
+
+static void run_alloc_step(int kind, size_t size, int nthreads, const std::vector<int>& cpus,
+                           int objects, int rounds)
+{
+    int ret = -1;
+    if (ecall_alloc_prepare(global_eid, &ret, kind, nthreads, objects, size) != SGX_SUCCESS || ret != 0) {
+        printf("Error: [%s] cannot prepare %d threads of %d objects of %lu bytes\n",
+                alloc_kinds[kind], nthreads, objects, (unsigned long)size);
+        return;
+    }
+
+    alloc_step_t step;
+    step.kind = kind;
+    step.size = size;
+    step.rounds = rounds;
+    step.errors = 0;
+    for (int t = 0; t < nthreads; ++t) {
+        alloc_thread_ctx_t ctx;
+        memset(&ctx, 0, sizeof(ctx));
+        ctx.cpu = cpus.empty() ? -1 : cpus[t % cpus.size()];
+        ctx.thread = t;
+        step.ctxs.push_back(ctx);
+    }
+
+    stats_result_t stats;
+    stats_measure(alloc_trial, &step, &stats);
+    if (step.errors) {
+        printf("Error: [%s] %d thread runs ran out of memory or TCS\n", alloc_kinds[kind], step.errors);
+        return;
+    }
+
+    /* per-op cycles and the fragmentation of the last trial */
+    uint64_t alloc_ops = 0, alloc_cycles = 0, free_ops = 0, free_cycles = 0;
+    uint64_t live = 0, footprint = 0;
+    for (int t = 0; t < nthreads; ++t) {
+        const alloc_bench_stats_t* s = &step.ctxs[t].stats;
+        alloc_ops += s->alloc_ops;
+        alloc_cycles += s->alloc_cycles;
+        free_ops += s->free_ops;
+        free_cycles += s->free_cycles;
+        if (s->live_bytes > live) {
+            live = s->live_bytes;
+            footprint = s->footprint;
+        }
+    }
+    double alloc_cost = alloc_ops ? (double)alloc_cycles / alloc_ops : 0.0;
+    double free_cost = free_ops ? (double)free_cycles / free_ops : 0.0;
+    double frag = live ? (double)footprint / live : 0.0;
+
+    char name[64], label[96], free_note[48];
+    if (free_ops)
+        snprintf(free_note, sizeof(free_note), "free %.0f cycles", free_cost);
+    else
+        snprintf(free_note, sizeof(free_note), "no free (alloc only)");
+    snprintf(name, sizeof(name), "[%s %luB]", alloc_kinds[kind], (unsigned long)size);
+    printf("%-30s [ threads: %d]    throughput is %.0f ± %.0f ops/s, alloc %.0f cycles, %s, "
+            "footprint/live %.2f, n=%d%s\n", name, nthreads, stats.mean, stats.ci, alloc_cost, free_note, frag,
+            stats.trials, stats.converged ? "" : ", ci target missed");
+
+    snprintf(label, sizeof(label), "%s %luB %d threads", alloc_kinds[kind], (unsigned long)size, nthreads);
+    results_add(label, "ops/s", &stats);
+    snprintf(label, sizeof(label), "%s %luB %d threads alloc", alloc_kinds[kind], (unsigned long)size, nthreads);
+    results_add_value(label, "cycles", alloc_cost);
+    if (free_ops) {
+        snprintf(label, sizeof(label), "%s %luB %d threads free", alloc_kinds[kind], (unsigned long)size, nthreads);
+        results_add_value(label, "cycles", free_cost);
+    }
+    snprintf(label, sizeof(label), "%s %luB %d threads footprint/live", alloc_kinds[kind], (unsigned long)size, nthreads);
+    results_add_value(label, "ratio", frag);
+}
+
+/* alloc_benchmark:
+ *   Sweep allocator, object size and thread count.
+ */
+void alloc_benchmark(long min_size, long max_size, int max_threads, const char* cpu_list, int objects, int rounds)
+{
+    std::vector<int> cpus = parse_cpu_list(cpu_list);
+
+    for (int kind = 0; kind < ALLOC_KIND_COUNT; ++kind) {
+        for (long size = min_size; size <= max_size; size *= 2) {
+            for (int nthreads = 1; nthreads <= max_threads; nthreads *= 2) {
+                run_alloc_step(kind, (size_t)size, nthreads, cpus, objects, rounds);
+                if (nthreads < max_threads && nthreads * 2 > max_threads)
+                    run_alloc_step(kind, (size_t)size, max_threads, cpus, objects, rounds);
+            }
+        }
+        ecall_alloc_finish(global_eid, kind, 1);
+    }
+}
@@ -0,0 +1,107 @@
+/* Async.cpp - asynchronous OCALL benchmark.
+ *
+ * Tasks alternate compute and IO. The blocking variants pay every IO in
+ * full, the async one keeps up to ntasks IOs in flight on the RPC workers
+ * and computes meanwhile. Overlap efficiency is the share of the ideal
+ * saving, rpc - max(compute only, io only), that the scheduler achieved.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../App.h"
+#include "Enclave_u.h"
+#include "rpc_ring.h"
+
+/* ocall_async_wait:
+ *   The IO of the blocking OCALL variant, same work as RPC_OP_WAIT.
+ */
+void ocall_async_wait(uint64_t cycles)
+{
+    uint64_t start_tsc = rdtsc();
+    while (rdtsc() - start_tsc < cycles)
+        __builtin_ia32_pause();
+}
+
+typedef struct _async_trial_t {
+    int ntasks;
+    int steps;
+    uint64_t compute_cycles;
+    uint64_t io_cycles;
+    int failed;
+    int trials;              /* measured trials summed below */
+    struct async_result_t sum;
+} async_trial_t;
+
+/* async cycles per step */
+static double async_trial(void* ctx, int warm)
+{
+    async_trial_t* t = (async_trial_t*)ctx;
+    struct async_result_t r;
+    int ret = -1;
+
+    if (ecall_async_benchmark(global_eid, &ret, t->ntasks, t->steps, t->compute_cycles, t->io_cycles, &r) != SGX_SUCCESS || ret != 0) {
+        t->failed = 1;
+        return 0.0;
+    }
+    if (!warm) {
+        t->sum.compute_only += r.compute_only;
+        t->sum.io_only += r.io_only;
+        t->sum.ocall += r.ocall;
+        t->sum.rpc += r.rpc;
+        t->sum.overlapped += r.overlapped;
+        if (r.peak_inflight > t->sum.peak_inflight)
+            t->sum.peak_inflight = r.peak_inflight;
+        t->trials++;
+    }
+    return (double)r.overlapped / ((double)t->ntasks * t->steps);
+}
+
+/* async_benchmark:
+ *   Sweep the compute : IO ratio of each step with io_cycles of IO. The
+ *   async figure comes with its CI, the other columns are averaged over the
+ *   same trials.
+ */
+void async_benchmark(int steps, int nworkers, int ntasks, uint64_t io_cycles)
+{
+    static const double ratios[] = { 0.25, 0.5, 1.0, 2.0, 4.0 };
+
+    rpc_engine_t* e = rpc_engine_start(nworkers, RPC_POLL_PAUSE, 256, 0);
+    if (e == NULL)
+        return;
+    printf("Info: async tasks: %d, steps per task: %d, io: %lu cycles, rpc workers: %d\n",
+            ntasks, steps, (unsigned long)io_cycles, nworkers);
+
+    for (size_t i = 0; i < sizeof(ratios) / sizeof(ratios[0]); ++i) {
+        async_trial_t trial;
+        stats_result_t stats;
+        char name[64], mean[160];
+
+        memset(&trial, 0, sizeof(trial));
+        trial.ntasks = ntasks;
+        trial.steps = steps;
+        trial.compute_cycles = (uint64_t)(ratios[i] * (double)io_cycles);
+        trial.io_cycles = io_cycles;
+        stats_measure(async_trial, &trial, &stats);
+        if (trial.failed || trial.trials == 0) {
+            printf("Error: ecall_async_benchmark failed\n");
+            break;
+        }
+
+        double total = (double)ntasks * steps * trial.trials;
+        const struct async_result_t* r = &trial.sum;
+        double ocall = r->ocall / total, rpc = r->rpc / total, overlapped = r->overlapped / total;
+        double bound = (r->compute_only > r->io_only ? r->compute_only : r->io_only) / total;
+        double efficiency = rpc > bound ? 100.0 * (rpc - overlapped) / (rpc - bound) : 0.0;
+
+        stats_format_cycles(&stats, mean, sizeof(mean));
+        printf("[async compute/io %.2f]  per step: ocall %.0f, rpc %.0f, compute only %.0f, io only %.0f cycles, async %s\n",
+                ratios[i], ocall, rpc, r->compute_only / total, r->io_only / total, mean);
+        printf("[async compute/io %.2f]  speedup vs ocall %.2fx, vs rpc %.2fx, overlap efficiency %.1f%%, peak inflight %d\n",
+                ratios[i], ocall / overlapped, rpc / overlapped, efficiency, r->peak_inflight);
+        snprintf(name, sizeof(name), "async compute/io %.2f", ratios[i]);
+        results_add(name, "cycles", &stats);
+    }
+
+    rpc_engine_stop(e);
+}
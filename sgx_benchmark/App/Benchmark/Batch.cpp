@@ -0,0 +1,129 @@
+/* Batch.cpp - batched command ECALL benchmark.
+ *
+ * Runs the same commands as one ECALL per command (ecall_batch_op) and
+ * packed into batches of 1, 2, 4, ... max_batch commands (ecall_batch),
+ * and reports the amortized cycles per command.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../App.h"
+#include "Enclave_u.h"
+#include "batch.h"
+
+struct batch_op_desc_t {
+    const char* name;
+    uint32_t opcode;
+    uint32_t payload_len;
+};
+
+static const batch_op_desc_t batch_ops[] = {
+    { "batch nop",          BATCH_OP_NOP,      0 },
+    { "batch add",          BATCH_OP_ADD,      0 },
+    { "batch checksum 64B", BATCH_OP_CHECKSUM, 64 },
+    { "batch fill 1KB",     BATCH_OP_FILL,     1024 },
+};
+
+/* Pack 'count' copies of op into buf, returns the buffer size */
+static size_t build_batch(uint8_t* buf, const batch_op_desc_t* op, int count)
+{
+    uint8_t* p = buf;
+    for (int i = 0; i < count; ++i) {
+        batch_cmd_t* cmd = (batch_cmd_t*)p;
+        cmd->opcode = op->opcode;
+        cmd->payload_len = op->payload_len;
+        cmd->arg0 = (uint64_t)i;
+        cmd->arg1 = 1;
+        cmd->result = 0;
+        memset(batch_cmd_payload(cmd), 1, op->payload_len);
+        p += batch_cmd_size(op->payload_len);
+    }
+    return (size_t)(p - buf);
+}
+
+static bool check_batch(uint8_t* buf, const batch_op_desc_t* op, int count)
+{
+    uint8_t* p = buf;
+    for (int i = 0; i < count; ++i) {
+        batch_cmd_t* cmd = (batch_cmd_t*)p;
+        if (cmd->result == BATCH_ERROR_OPCODE)
+            return false;
+        if (op->opcode == BATCH_OP_ADD && cmd->result != (int64_t)(cmd->arg0 + cmd->arg1))
+            return false;
+        p += batch_cmd_size(op->payload_len);
+    }
+    return true;
+}
+
+typedef struct _batch_trial_t {
+    const batch_op_desc_t* op;
+    unsigned long loops;
+    uint8_t* buf;      /* payload of a single op, or the packed batch */
+    size_t size;
+    int batch;         /* 0: one ecall_batch_op per command */
+    int executed;
+} batch_trial_t;
+
+/* cycles per command */
+static double batch_trial(void* ctx, int warm)
+{
+    batch_trial_t* t = (batch_trial_t*)ctx;
+    int64_t result = 0;
+
+    uint64_t start_tsc = rdtsc();
+    if (t->batch == 0) {
+        for (unsigned long i = 0; i < t->loops; ++i)
+            ecall_batch_op(global_eid, &result, t->op->opcode, i, 1, t->buf, t->op->payload_len);
+    } else {
+        for (unsigned long loop = 0; loop < t->loops; ++loop)
+            ecall_batch(global_eid, &t->executed, t->buf, t->size, t->batch);
+    }
+    uint64_t cycles = timing_since(start_tsc);
+    return (double)cycles / (double)(t->loops * (t->batch ? t->batch : 1));
+}
+
+/* batch_benchmark:
+ *   Every trial executes about total_ops commands.
+ */
+void batch_benchmark(unsigned long total_ops, int max_batch)
+{
+    size_t nops = sizeof(batch_ops) / sizeof(batch_ops[0]);
+    stats_result_t single, stats;
+    char name[64], mean[160];
+
+    for (size_t o = 0; o < nops; ++o) {
+        const batch_op_desc_t* op = &batch_ops[o];
+        uint8_t* buf = (uint8_t*)malloc(batch_cmd_size(op->payload_len) * max_batch);
+
+        memset(buf, 1, op->payload_len);
+        batch_trial_t trial = { op, total_ops, buf, op->payload_len, 0, 0 };
+        stats_measure(batch_trial, &trial, &single);
+        stats_format_cycles(&single, mean, sizeof(mean));
+        printf("%-30s [ single ecall ]    time per op is %s\n", op->name, mean);
+        snprintf(name, sizeof(name), "%s single ecall", op->name);
+        results_add(name, "cycles", &single);
+
+        for (int batch = 1; batch <= max_batch; batch *= 2) {
+            trial.size = build_batch(buf, op, batch);
+            trial.loops = total_ops / batch ? total_ops / batch : 1;
+            trial.batch = batch;
+            trial.executed = 0;
+            stats_measure(batch_trial, &trial, &stats);
+
+            if (trial.executed != batch || !check_batch(buf, op, batch)) {
+                printf("Error: [%s] batch of %d returned wrong results\n", op->name, batch);
+                break;
+            }
+
+            stats_format_cycles(&stats, mean, sizeof(mean));
+            printf("%-30s [ batch: %d, loops: %lu]    time per op is %s, speedup is %.2fx\n",
+                    op->name, batch, trial.loops, mean, single.mean / stats.mean);
+            snprintf(name, sizeof(name), "%s batch %d", op->name, batch);
+            results_add(name, "cycles", &stats);
+        }
+
+        free(buf);
+    }
+}
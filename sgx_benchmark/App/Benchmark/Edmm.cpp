@@ -0,0 +1,141 @@
+/* Edmm.cpp - EDMM allocate / free scaling with other enclave threads running.
+ *
+ * K worker threads (1, 2, 4, ... max_threads) allocate, touch, restrict and
+ * free reserved memory at the same time, while `busy` more threads spin
+ * inside the enclave. Restrict and free need a TLB shootdown of every CPU
+ * running the enclave, so their latency grows with the number of threads
+ * inside, not only with the workers. Needs EDMM and K + busy TCS.
+ */
+
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../App.h"
+#include "Enclave_u.h"
+#include "histogram.h"
+
+#define EDMM_STEPS 4
+
+static const char* edmm_steps[EDMM_STEPS] = { "alloc", "touch", "restrict", "free" };
+
+struct edmm_thread_ctx_t {
+    int cpu;               /* -1 means no affinity */
+    int ret;
+    long loops;            /* busy threads */
+    histogram_t hists[EDMM_STEPS];
+};
+
+static std::atomic<int> edmm_ready(0);
+static std::atomic<bool> edmm_go(false);
+static int edmm_stop = 0;
+static int edmm_entered = 0;  /* busy threads inside, or that failed to enter */
+
+static void edmm_set_cpu(int cpu)
+{
+    if (cpu < 0)
+        return;
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    CPU_SET(cpu, &mask);
+    sched_setaffinity(0, sizeof(mask), &mask);
+}
+
+static void edmm_busy_thread(edmm_thread_ctx_t* ctx)
+{
+    edmm_set_cpu(ctx->cpu);
+    if (ecall_edmm_busy(global_eid, &ctx->loops, &edmm_stop, &edmm_entered) != SGX_SUCCESS || ctx->loops < 0) {
+        ctx->ret = -1;
+        __atomic_add_fetch(&edmm_entered, 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+static void edmm_worker_thread(edmm_thread_ctx_t* ctx, int page_num, int iterations)
+{
+    edmm_set_cpu(ctx->cpu);
+    edmm_ready++;
+    while (!edmm_go.load())
+        __builtin_ia32_pause();
+    if (ecall_edmm_worker(global_eid, &ctx->ret, page_num, iterations, ctx->hists, EDMM_STEPS) != SGX_SUCCESS)
+        ctx->ret = -1;
+}
+
+static void run_edmm_step(int nworkers, int nbusy, const std::vector<int>& cpus, int page_num, int iterations)
+{
+    int nthreads = nworkers + nbusy;
+    std::vector<edmm_thread_ctx_t*> ctxs;
+    std::vector<std::thread> threads;
+
+    for (int t = 0; t < nthreads; ++t) {
+        edmm_thread_ctx_t* ctx = (edmm_thread_ctx_t*)calloc(1, sizeof(edmm_thread_ctx_t));
+        ctx->cpu = cpus.empty() ? -1 : cpus[t % cpus.size()];
+        ctxs.push_back(ctx);
+    }
+
+    /* busy threads first, they should be inside before the workers start */
+    edmm_ready = 0;
+    edmm_go = false;
+    __atomic_store_n(&edmm_stop, 0, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&edmm_entered, 0, __ATOMIC_SEQ_CST);
+    for (int t = nworkers; t < nthreads; ++t)
+        threads.push_back(std::thread(edmm_busy_thread, ctxs[t]));
+    for (int t = 0; t < nworkers; ++t)
+        threads.push_back(std::thread(edmm_worker_thread, ctxs[t], page_num, iterations));
+    while (edmm_ready.load() < nworkers || __atomic_load_n(&edmm_entered, __ATOMIC_SEQ_CST) < nbusy)
+        __builtin_ia32_pause();
+    edmm_go = true;
+
+    for (int t = 0; t < nworkers; ++t)
+        threads[nbusy + t].join();
+    __atomic_store_n(&edmm_stop, 1, __ATOMIC_SEQ_CST);
+    for (int t = 0; t < nbusy; ++t)
+        threads[t].join();
+
+    int errors = 0;
+    histogram_t all[EDMM_STEPS];
+    for (int s = 0; s < EDMM_STEPS; ++s)
+        hist_reset(&all[s]);
+    for (int t = 0; t < nthreads; ++t) {
+        if (ctxs[t]->ret != 0)
+            errors++;
+        if (t < nworkers) {
+            for (int s = 0; s < EDMM_STEPS; ++s)
+                hist_merge(&all[s], &ctxs[t]->hists[s]);
+        }
+    }
+    for (int t = 0; t < nthreads; ++t)
+        free(ctxs[t]);
+    if (errors) {
+        printf("Error: [edmm] %d of %d threads failed (no EDMM, out of TCS or reserved memory)\n", errors, nthreads);
+        return;
+    }
+
+    char name[64], label[96], percentiles[256];
+    for (int s = 0; s < EDMM_STEPS; ++s) {
+        hist_format(&all[s], percentiles, sizeof(percentiles));
+        snprintf(name, sizeof(name), "[edmm %s %d pages]", edmm_steps[s], page_num);
+        printf("%-30s [ workers: %d, busy: %d]    time is %lu ± %.0f cycles (%.1f ns), n=%lu, %s\n",
+                name, nworkers, nbusy, (unsigned long)hist_mean(&all[s]), hist_ci95(&all[s]),
+                timing_ns((double)hist_mean(&all[s])), (unsigned long)all[s].count, percentiles);
+        snprintf(label, sizeof(label), "edmm %s %d workers %d busy", edmm_steps[s], nworkers, nbusy);
+        results_add_hist(label, "cycles", &all[s], 1.0);
+    }
+}
+
+/* edmm_scaling_benchmark:
+ *   iterations is per worker.
+ */
+void edmm_scaling_benchmark(int page_num, int iterations, int max_threads, int nbusy, const char* cpu_list)
+{
+    std::vector<int> cpus = parse_cpu_list(cpu_list);
+
+    for (int nworkers = 1; nworkers <= max_threads; nworkers *= 2) {
+        run_edmm_step(nworkers, nbusy, cpus, page_num, iterations);
+        if (nworkers < max_threads && nworkers * 2 > max_threads)
+            run_edmm_step(max_threads, nbusy, cpus, page_num, iterations);
+    }
+}
@@ -0,0 +1,219 @@
+/* Epc.cpp - EPC oversubscription sweep.
+ *
+ * Reads the EPC size (sgx sysfs of the kernel driver, CPUID leaf 0x12
+ * otherwise) and the LLC size, and times random page touches in the enclave
+ * on buffers around both. The paging knee is the largest buffer whose
+ * touches stay below `factor` times the in-EPC cost, refined by bisection.
+ * Past the knee, a touch misses the EPC with probability 1 - knee / size,
+ * which gives the cost of one page swap (#PF + AEX + EWB + ELDU).
+ */
+
+#include <algorithm>
+#include <cpuid.h>
+#include <glob.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+#include "../App.h"
+#include "Enclave_u.h"
+
+#define EPC_MB            (1024.0 * 1024.0)
+#define EPC_REFINE_STEPS  4
+#define EPC_DEFAULT_LLC   (32L << 20)
+
+/* Sum of the sgx_total_bytes of every NUMA node, 0 if there is none */
+static uint64_t epc_size_sysfs(void)
+{
+    glob_t g;
+    uint64_t total = 0;
+    if (glob("/sys/devices/system/node/node*/x86/sgx_total_bytes", 0, NULL, &g) != 0)
+        return 0;
+    for (size_t i = 0; i < g.gl_pathc; ++i) {
+        FILE* f = fopen(g.gl_pathv[i], "r");
+        unsigned long long bytes = 0;
+        if (f != NULL && fscanf(f, "%llu", &bytes) == 1)
+            total += bytes;
+        if (f != NULL)
+            fclose(f);
+    }
+    globfree(&g);
+    return total;
+}
+
+/* Sum of the EPC sections of CPUID leaf 0x12, sub-leaf 2 and up */
+static uint64_t epc_size_cpuid(void)
+{
+    unsigned int eax, ebx, ecx, edx;
+    uint64_t total = 0;
+    if (__get_cpuid_max(0, NULL) < 0x12)
+        return 0;
+    for (unsigned int sub = 2; sub < 2 + 64; ++sub) {
+        __cpuid_count(0x12, sub, eax, ebx, ecx, edx);
+        if ((eax & 0xf) != 1)
+            break;
+        total += ((uint64_t)(edx & 0xfffff) << 32) | (ecx & 0xfffff000);
+    }
+    return total;
+}
+
+static long llc_size(void)
+{
+    long llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if (llc <= 0)
+        llc = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    return llc > 0 ? llc : EPC_DEFAULT_LLC;
+}
+
+typedef struct _epc_trial_t {
+    long accesses;
+    uint64_t seed;
+} epc_trial_t;
+
+/* cycles per touch */
+static double epc_trial(void* ctx, int warm)
+{
+    epc_trial_t* t = (epc_trial_t*)ctx;
+    uint64_t cycles = 0;
+    ecall_epc_touch(global_eid, &cycles, t->accesses, t->seed++);
+    return (double)cycles / (double)t->accesses;
+}
+
+struct epc_point_t {
+    uint64_t bytes;
+    double cycles;  /* per touch, 0 if the buffer was not available */
+};
+
+static double epc_measure(uint64_t bytes, long accesses)
+{
+    int ret = -1;
+    if (ecall_epc_prepare(global_eid, &ret, (size_t)bytes) != SGX_SUCCESS || ret != 0) {
+        printf("Error: no %.0f MB of reserved memory, raise ReservedMemMaxSize of the config\n",
+                (double)bytes / EPC_MB);
+        return 0.0;
+    }
+
+    epc_trial_t trial = { accesses, 1 };
+    stats_result_t stats;
+    char mean[160], name[64];
+    stats_measure(epc_trial, &trial, &stats);
+    ecall_epc_release(global_eid);
+
+    stats_format_cycles(&stats, mean, sizeof(mean));
+    printf("%-30s [ %.1f MB]    time per touch is %s\n", "[epc random page touch]", (double)bytes / EPC_MB, mean);
+    snprintf(name, sizeof(name), "epc touch %.1f MB", (double)bytes / EPC_MB);
+    results_add(name, "cycles", &stats);
+    return stats.mean;
+}
+
+static bool epc_point_less(const epc_point_t& a, const epc_point_t& b)
+{
+    return a.bytes < b.bytes;
+}
+
+/* epc_benchmark:
+ *   max_mb caps the largest buffer (0: twice the EPC), accesses is per trial.
+ */
+void epc_benchmark(long accesses, long max_mb, double factor)
+{
+    uint64_t epc = epc_size_sysfs();
+    const char* source = "sysfs";
+    if (epc == 0) {
+        epc = epc_size_cpuid();
+        source = "cpuid";
+    }
+    if (epc == 0) {
+        printf("Error: no EPC found in sysfs nor CPUID leaf 0x12\n");
+        return;
+    }
+    uint64_t llc = (uint64_t)llc_size();
+    uint64_t max_bytes = max_mb > 0 ? (uint64_t)max_mb << 20 : 2 * epc;
+    printf("Info: EPC %.1f MB (%s), LLC %.1f MB\n", (double)epc / EPC_MB, source, (double)llc / EPC_MB);
+    results_add_value("epc size", "bytes", (double)epc);
+    results_add_value("llc size", "bytes", (double)llc);
+
+    static const double llc_steps[] = { 0.25, 0.5, 0.75, 1.0, 1.25, 1.5, 2.0, 4.0 };
+    static const double epc_steps[] = { 0.25, 0.5, 0.75, 0.85, 0.9, 0.95, 1.0, 1.05, 1.1, 1.25, 1.5, 2.0 };
+    std::vector<epc_point_t> points;
+    for (size_t i = 0; i < sizeof(llc_steps) / sizeof(llc_steps[0]); ++i)
+        points.push_back({ (uint64_t)(llc * llc_steps[i]) & ~(uint64_t)4095, 0.0 });
+    for (size_t i = 0; i < sizeof(epc_steps) / sizeof(epc_steps[0]); ++i)
+        points.push_back({ (uint64_t)(epc * epc_steps[i]) & ~(uint64_t)4095, 0.0 });
+    std::sort(points.begin(), points.end(), epc_point_less);
+
+    std::vector<epc_point_t> done;
+    for (size_t i = 0; i < points.size(); ++i) {
+        if (points[i].bytes == 0 || points[i].bytes > max_bytes ||
+            (!done.empty() && done.back().bytes == points[i].bytes))
+            continue;
+        points[i].cycles = epc_measure(points[i].bytes, accesses);
+        if (points[i].cycles > 0.0)
+            done.push_back(points[i]);
+    }
+
+    /* in-EPC plateau: past the LLC (unless it is as large as the EPC), up to
+     * 3/4 of the EPC
+     */
+    uint64_t cached = llc < epc / 2 ? llc : 0;
+    std::vector<double> plateau;
+    for (size_t i = 0; i < done.size(); ++i) {
+        if (done[i].bytes > cached && done[i].bytes <= epc * 3 / 4)
+            plateau.push_back(done[i].cycles);
+    }
+    if (plateau.empty()) {
+        printf("Error: no point between the LLC size and 3/4 of the EPC, no knee to look for\n");
+        return;
+    }
+    std::sort(plateau.begin(), plateau.end());
+    double base = plateau[plateau.size() / 2];
+
+    size_t first = 0;
+    while (first < done.size() && (done[first].bytes <= cached || done[first].cycles <= factor * base))
+        first++;
+    if (first == done.size() || first == 0) {
+        printf("Info: touches stay within %.1fx of %.0f cycles up to %.1f MB, no paging knee\n",
+                factor, base, (double)done.back().bytes / EPC_MB);
+        return;
+    }
+
+    /* bisect between the last point below the threshold and the first above */
+    uint64_t lo = done[first - 1].bytes, hi = done[first].bytes;
+    for (int step = 0; step < EPC_REFINE_STEPS && hi - lo > 2 * 4096; ++step) {
+        uint64_t mid = (lo + (hi - lo) / 2) & ~(uint64_t)4095;
+        double cycles = epc_measure(mid, accesses);
+        if (cycles <= 0.0)
+            break;
+        done.push_back({ mid, cycles });
+        if (cycles > factor * base)
+            hi = mid;
+        else
+            lo = mid;
+    }
+    std::sort(done.begin(), done.end(), epc_point_less);
+    uint64_t knee = lo;
+    printf("%-30s paging knee at %.1f MB (%.0f%% of the EPC), in-EPC touch %.0f cycles\n",
+            "[epc]", (double)knee / EPC_MB, 100.0 * knee / epc, base);
+    results_add_value("epc paging knee", "bytes", (double)knee);
+
+    /* t(size) = base + (1 - knee / size) * swap, from the points well past the knee */
+    std::vector<double> swaps;
+    for (size_t i = 0; i < done.size(); ++i) {
+        if (done[i].bytes < knee + knee / 4)
+            continue;
+        double miss = 1.0 - (double)knee / (double)done[i].bytes;
+        double swap = (done[i].cycles - base) / miss;
+        printf("    %.1f MB: miss ratio %.2f, %.0f cycles per page swap\n", (double)done[i].bytes / EPC_MB, miss, swap);
+        swaps.push_back(swap);
+    }
+    if (swaps.empty()) {
+        printf("Info: no point 25%% past the knee, raise max_mb to estimate the page swap cost\n");
+        return;
+    }
+    std::sort(swaps.begin(), swaps.end());
+    double swap = swaps[swaps.size() / 2];
+    printf("%-30s page swap (#PF + AEX + EWB + ELDU) is %.0f cycles (%.1f us)\n",
+            "[epc]", swap, timing_ns(swap) / 1000.0);
+    results_add_value("epc page swap", "cycles", swap);
+}
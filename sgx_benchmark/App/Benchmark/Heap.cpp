@@ -0,0 +1,84 @@
+/* Heap.cpp - malloc latency while the enclave heap grows from HeapMinSize.
+ *
+ * Every object size runs in a freshly loaded enclave of the benchmark's
+ * config, mallocs total_mb of objects and reports the latency of every
+ * malloc, of the mallocs that grew the heap (the spikes), and the first one
+ * (time to first byte). Compare a growing heap (heap-grow, config.02) with a
+ * heap committed at load (heap-static): `--config heap-grow,heap-static`.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "sgx_urts.h"
+#include "../App.h"
+#include "Enclave_u.h"
+#include "heap_growth.h"
+
+#define HEAP_MB (1024.0 * 1024.0)
+
+static void print_heap_hist(const char* name, size_t size, const histogram_t* hist, const char* extra)
+{
+    char percentiles[256], label[96];
+    hist_format(hist, percentiles, sizeof(percentiles));
+    printf("%-30s [ %lu bytes]    time is %lu ± %.0f cycles (%.1f ns), n=%lu, %s%s\n", name, (unsigned long)size,
+            (unsigned long)hist_mean(hist), hist_ci95(hist), timing_ns((double)hist_mean(hist)),
+            (unsigned long)hist->count, percentiles, extra);
+    snprintf(label, sizeof(label), "%s %luB", name, (unsigned long)size);
+    results_add_hist(label, "cycles", hist, 1.0);
+}
+
+/* heap_growth_benchmark:
+ *   sizes is a comma separated list of object sizes.
+ */
+int heap_growth_benchmark(const char* config, const char* sizes, long total_mb)
+{
+    std::vector<size_t> object_sizes;
+    for (const char* p = sizes; p && *p; ) {
+        char* end = NULL;
+        unsigned long size = strtoul(p, &end, 0);
+        if (end == p || size < 16) {
+            printf("Error: heap object sizes should be a list of sizes >= 16, got '%s'\n", sizes);
+            return -1;
+        }
+        object_sizes.push_back(size);
+        p = *end == ',' ? end + 1 : NULL;
+    }
+
+    heap_growth_t* result = (heap_growth_t*)malloc(sizeof(heap_growth_t));
+    int failures = 0;
+    for (size_t i = 0; i < object_sizes.size(); ++i) {
+        if (initialize_enclave(config) < 0) {
+            free(result);
+            return -1;
+        }
+        int ret = -1;
+        sgx_status_t status = ecall_heap_growth(global_eid, &ret, object_sizes[i], (size_t)total_mb << 20, result);
+        sgx_destroy_enclave(global_eid);
+        if (status != SGX_SUCCESS || ret != 0) {
+            printf("Error: [heap growth] %lu byte objects failed\n", (unsigned long)object_sizes[i]);
+            failures++;
+            continue;
+        }
+
+        char extra[128];
+        double grown = (double)(result->heap_end - result->heap_start) / HEAP_MB;
+        snprintf(extra, sizeof(extra), ", heap +%.1f MB for %lu objects", grown, (unsigned long)result->objects);
+        print_heap_hist("[heap malloc]", object_sizes[i], &result->all, extra);
+        if (result->steps) {
+            snprintf(extra, sizeof(extra), ", %.1f KB per step",
+                     (double)(result->heap_end - result->heap_start) / result->steps / 1024.0);
+            print_heap_hist("[heap growth step]", object_sizes[i], &result->growth, extra);
+        }
+        printf("%-30s [ %lu bytes]    time is %lu cycles (%.1f ns)\n", "[heap first byte]",
+                (unsigned long)object_sizes[i], (unsigned long)result->first_byte,
+                timing_ns((double)result->first_byte));
+        snprintf(extra, sizeof(extra), "heap first byte %luB", (unsigned long)object_sizes[i]);
+        results_add_value(extra, "cycles", (double)result->first_byte);
+    }
+    free(result);
+    return failures ? -1 : 0;
+}
@@ -0,0 +1,217 @@
+/* Malloc.cpp - malloc / free workloads, in the enclave (tlibc) vs on the host (glibc).
+ *
+ * Every point of the sweep runs the workload of Include/malloc_bench.h on the
+ * host first, then in the enclave, with the same threads:
+ *   sizes    object size min_size .. max_size (doubling)
+ *   xfree    the same sizes, producer / consumer thread pairs
+ *   realloc  growth up to realloc_max bytes
+ *   larson   random sizes 16 .. max_size
+ * each for 1, 2, 4, ... max_threads threads. Reported are ops/s (all threads),
+ * the enclave slowdown, and the peak memory use: resident set of the process
+ * on the host, heap below the break (EPC under EDMM) in the enclave.
+ */
+
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../App.h"
+#include "Enclave_u.h"
+#include "malloc_bench.h"
+
+#define MALLOC_SIDE_HOST    0
+#define MALLOC_SIDE_ENCLAVE 1
+
+static const char* malloc_cases[MALLOC_CASE_COUNT] = { "sizes", "xfree", "realloc", "larson" };
+static const char* malloc_sides[] = { "host", "enclave" };
+
+static malloc_bench_t host_bench;
+static int host_statm_fd = -1;
+static uint64_t host_page_size = 4096;
+
+/* Resident bytes of the process. It runs inside the timed loop, so one
+ * pread of the statm opened at setup and no stdio, which would malloc.
+ */
+static uint64_t host_rss(void)
+{
+    char buf[128];
+    ssize_t len = pread(host_statm_fd, buf, sizeof(buf) - 1, 0);
+    if (len <= 0)
+        return 0;
+    buf[len] = '\0';
+    char* resident = strchr(buf, ' ');  /* "size resident shared ..." */
+    return resident ? strtoull(resident + 1, NULL, 10) * host_page_size : 0;
+}
+
+struct malloc_step_t {
+    int side;
+    std::vector<int> cpus;
+    int nthreads;
+    int trial;
+    std::vector<long> done;  /* ops of every thread, -1 on failure */
+    int errors;
+};
+
+static std::atomic<int> malloc_ready(0);
+static std::atomic<bool> malloc_go(false);
+static int malloc_abort = 0;  /* a thread of the trial could not run */
+
+static void malloc_thread(malloc_step_t* step, int thread)
+{
+    if (!step->cpus.empty()) {
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        CPU_SET(step->cpus[thread % step->cpus.size()], &mask);
+        sched_setaffinity(0, sizeof(mask), &mask);
+    }
+
+    malloc_ready++;
+    while (!malloc_go.load())
+        __builtin_ia32_pause();
+
+    long done = -1;
+    if (step->side == MALLOC_SIDE_HOST)
+        done = malloc_bench_thread(&host_bench, thread, step->trial);
+    else if (ecall_malloc_bench_thread(global_eid, &done, thread, step->trial) != SGX_SUCCESS) {
+        done = -1;  /* e.g. out of TCS, an xfree partner would wait forever */
+        __atomic_store_n(&malloc_abort, 1, __ATOMIC_SEQ_CST);
+    }
+    step->done[thread] = done;
+}
+
+/* One trial: every thread runs its ops, returns ops/s of all of them */
+static double malloc_trial(void* arg, int warm)
+{
+    malloc_step_t* step = (malloc_step_t*)arg;
+    std::vector<std::thread> threads;
+
+    if (step->errors)
+        return 0.0;  /* the point failed, do not run it again */
+    malloc_ready = 0;
+    malloc_go = false;
+    __atomic_store_n(&malloc_abort, 0, __ATOMIC_SEQ_CST);
+    for (int t = 0; t < step->nthreads; ++t)
+        threads.push_back(std::thread(malloc_thread, step, t));
+
+    while (malloc_ready.load() < step->nthreads)
+        __builtin_ia32_pause();
+    double start_sec = wall_time_sec();
+    malloc_go = true;
+    for (int t = 0; t < step->nthreads; ++t)
+        threads[t].join();
+    double stop_sec = wall_time_sec();
+    step->trial++;
+
+    long ops = 0;
+    for (int t = 0; t < step->nthreads; ++t) {
+        if (step->done[t] < 0)
+            step->errors++;
+        else
+            ops += step->done[t];
+    }
+    return (double)ops / (stop_sec - start_sec);
+}
+
+/* ops/s of one side, 0 on failure */
+static double run_malloc_side(int side, int mcase, size_t size, int nthreads, const std::vector<int>& cpus,
+                              long ops, double host_ops)
+{
+    int ret = -1;
+    uint64_t peak = 0;
+    if (side == MALLOC_SIDE_HOST)
+        ret = malloc_bench_setup(&host_bench, mcase, nthreads, size, ops, host_rss, &malloc_abort);
+    else if (ecall_malloc_bench_setup(global_eid, &ret, mcase, nthreads, size, ops, &malloc_abort) != SGX_SUCCESS)
+        ret = -1;
+    if (ret != 0) {
+        printf("Error: [%s %s] cannot set up %d threads of %lu bytes\n",
+                malloc_sides[side], malloc_cases[mcase], nthreads, (unsigned long)size);
+        return 0.0;
+    }
+
+    malloc_step_t step;
+    step.side = side;
+    step.cpus = cpus;
+    step.nthreads = nthreads;
+    step.trial = 0;
+    step.done.assign(nthreads, 0);
+    step.errors = 0;
+
+    stats_result_t stats;
+    stats_measure(malloc_trial, &step, &stats);
+
+    if (side == MALLOC_SIDE_HOST) {
+        malloc_bench_teardown(&host_bench);
+        peak = host_bench.peak;
+    } else {
+        ecall_malloc_bench_teardown(global_eid, &peak);
+    }
+    if (step.errors) {
+        printf("Error: [%s %s] %d thread runs failed (out of memory or TCS)\n",
+                malloc_sides[side], malloc_cases[mcase], step.errors);
+        return 0.0;
+    }
+
+    char name[64], slowdown[32] = "", label[96];
+    snprintf(name, sizeof(name), "[%s %s %luB]", malloc_sides[side], malloc_cases[mcase], (unsigned long)size);
+    if (side == MALLOC_SIDE_ENCLAVE && host_ops > 0.0)
+        snprintf(slowdown, sizeof(slowdown), ", %.2fx host", host_ops / stats.mean);
+    printf("%-30s [ threads: %d]    throughput is %.0f ± %.0f ops/s%s, peak %.1f MB, n=%d%s\n",
+            name, nthreads, stats.mean, stats.ci, slowdown, (double)peak / (1024 * 1024),
+            stats.trials, stats.converged ? "" : ", ci target missed");
+
+    snprintf(label, sizeof(label), "%s %s %luB %d threads", malloc_sides[side], malloc_cases[mcase],
+             (unsigned long)size, nthreads);
+    results_add(label, "ops/s", &stats);
+    snprintf(label, sizeof(label), "%s %s %luB %d threads peak", malloc_sides[side], malloc_cases[mcase],
+             (unsigned long)size, nthreads);
+    results_add_value(label, "bytes", (double)peak);
+    return stats.mean;
+}
+
+static void run_malloc_point(int mcase, size_t size, int nthreads, const std::vector<int>& cpus, long ops)
+{
+    double host_ops = run_malloc_side(MALLOC_SIDE_HOST, mcase, size, nthreads, cpus, ops, 0.0);
+    run_malloc_side(MALLOC_SIDE_ENCLAVE, mcase, size, nthreads, cpus, ops, host_ops);
+}
+
+static void run_malloc_threads(int mcase, size_t size, int max_threads, const std::vector<int>& cpus, long ops)
+{
+    /* xfree needs whole pairs */
+    int first = mcase == MALLOC_CASE_XFREE ? 2 : 1;
+    int last = mcase == MALLOC_CASE_XFREE ? max_threads & ~1 : max_threads;
+    for (int nthreads = first; nthreads <= last; nthreads *= 2) {
+        run_malloc_point(mcase, size, nthreads, cpus, ops);
+        if (nthreads < last && nthreads * 2 > last)
+            run_malloc_point(mcase, size, last, cpus, ops);
+    }
+}
+
+/* malloc_benchmark:
+ *   ops is per thread and trial.
+ */
+void malloc_benchmark(long min_size, long max_size, long realloc_max, int max_threads, const char* cpu_list, long ops)
+{
+    std::vector<int> cpus = parse_cpu_list(cpu_list);
+
+    host_statm_fd = open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+    host_page_size = (uint64_t)sysconf(_SC_PAGESIZE);
+    if (host_statm_fd < 0)
+        printf("Info: cannot open /proc/self/statm, no host peak\n");
+
+    for (long size = min_size; size <= max_size; size *= 2)
+        run_malloc_threads(MALLOC_CASE_SIZES, (size_t)size, max_threads, cpus, ops);
+    for (long size = min_size; size <= max_size; size *= 2)
+        run_malloc_threads(MALLOC_CASE_XFREE, (size_t)size, max_threads, cpus, ops);
+    run_malloc_threads(MALLOC_CASE_REALLOC, (size_t)realloc_max, max_threads, cpus, ops);
+    run_malloc_threads(MALLOC_CASE_LARSON, (size_t)max_size, max_threads, cpus, ops);
+
+    if (host_statm_fd >= 0)
+        close(host_statm_fd);
+    host_statm_fd = -1;
+}
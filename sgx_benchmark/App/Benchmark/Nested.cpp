@@ -0,0 +1,109 @@
+/* Nested.cpp - nested OCALL -> ECALL re-entrancy benchmark.
+ *
+ * Depth d means one root ECALL plus d OCALL -> nested ECALL round trips,
+ * all with an [in, out] payload of len longs.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../App.h"
+#include "Enclave_u.h"
+#include "histogram.h"
+
+/* ocall_nested:
+ *   Re-enter the enclave one level deeper, allowed by the EDL [allow] list.
+ */
+void ocall_nested(int depth, long* buf, int len)
+{
+    if (ecall_nested(global_eid, depth - 1, buf, len) != SGX_SUCCESS)
+        abort();
+}
+
+typedef struct _nested_arg_t {
+    int depth;
+    long* ptr;
+    int len;
+    unsigned long loops;
+} nested_arg_t;
+
+static void call_ecall_inout(void* arg)
+{
+    nested_arg_t* a = (nested_arg_t*)arg;
+    ecall_inout(global_eid, a->ptr, a->len);
+}
+
+static void run_ocall_inout(void* arg, histogram_t* hist)
+{
+    nested_arg_t* a = (nested_arg_t*)arg;
+    ecall_ocall_inout(global_eid, (int)a->loops, a->len);
+    ecall_get_ocall_histogram(global_eid, hist);
+}
+
+static void call_nested_enter(void* arg)
+{
+    nested_arg_t* a = (nested_arg_t*)arg;
+    ecall_nested_enter(global_eid, a->depth, a->ptr, a->len);
+}
+
+static void nested_benchmark_len(unsigned long loops, int max_depth, int len)
+{
+    static histogram_t hist;
+    nested_arg_t arg = { 0, (long*)malloc(len * sizeof(long)), len, loops };
+    stats_result_t stats;
+    char name[64];
+
+    /* plain transitions with the same payload, for comparison */
+    call_trial_t ecall_trial = { call_ecall_inout, &arg, loops, &hist };
+    hist_reset(&hist);
+    stats_measure(call_trial, &ecall_trial, &stats);
+    snprintf(name, sizeof(name), "[nested plain ecall (long[%d])]", len);
+    print_switching_hist(name, &hist, &stats);
+    double plain_ecall = stats.mean;
+
+    hist_trial_t ocall_trial = { run_ocall_inout, &arg, &hist };
+    hist_reset(&hist);
+    stats_measure(hist_trial, &ocall_trial, &stats);
+    snprintf(name, sizeof(name), "[nested plain ocall (long[%d])]", len);
+    print_switching_hist(name, &hist, &stats);
+    double plain_ocall = stats.mean;
+
+    stats_result_t depth0;
+    for (int depth = 0; depth <= max_depth; ++depth) {
+        call_trial_t trial = { call_nested_enter, &arg, loops, &hist };
+        arg.depth = depth;
+        hist_reset(&hist);
+        stats_measure(call_trial, &trial, &stats);
+
+        snprintf(name, sizeof(name), "[nested depth %d (long[%d])]", depth, len);
+        print_switching_hist(name, &hist, &stats);
+
+        if (depth == 0) {
+            depth0 = stats;
+        } else {
+            /* (depth d - depth 0) / d, the CIs of both means add in quadrature */
+            stats_result_t per_level = stats;
+            per_level.mean = (stats.mean - depth0.mean) / depth;
+            per_level.ci = sqrt(stats.ci * stats.ci + depth0.ci * depth0.ci) / depth;
+            per_level.stddev = sqrt(stats.stddev * stats.stddev + depth0.stddev * depth0.stddev) / depth;
+            per_level.converged = stats.converged && depth0.converged;
+            printf("    per level is %.0f ± %.0f cycles (%.1f ns), plain ocall + ecall is %.0f cycles\n",
+                    per_level.mean, per_level.ci, timing_ns(per_level.mean), plain_ocall + plain_ecall);
+            snprintf(name, sizeof(name), "nested per level depth %d (long[%d])", depth, len);
+            results_add(name, "cycles", &per_level);
+        }
+    }
+
+    free(arg.ptr);
+}
+
+/* nested_benchmark:
+ *   Time ECALL -> OCALL -> nested ECALL chains of depth 0..max_depth with a
+ *   small (1 long) and a large (len longs) payload.
+ */
+void nested_benchmark(unsigned long loops, int max_depth, int len)
+{
+    nested_benchmark_len(loops, max_depth, 1);
+    nested_benchmark_len(loops, max_depth, len);
+}
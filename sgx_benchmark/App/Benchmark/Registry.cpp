@@ -0,0 +1,724 @@
+/* Registry.cpp - benchmark registry and command line.
+ *
+ * Every benchmark declares its parameters with their defaults, the enclave
+ * config it is meant to run with and the kind of enclave it needs. One
+ * process runs any subset of them, with repetitions, parameter sweeps and
+ * other configs, and keeps the enclave loaded as long as consecutive runs
+ * can share it. The Makefile signs one image per config.
+ *
+ *   ./bench <affinity> <bench> [values]    one run, values in parameter order
+ *   ./bench <affinity> list                 benchmarks, parameters, defaults
+ *   ./bench <affinity> run [options] [filter...]
+ *   ./bench <affinity> compare BASE CURRENT [--threshold PCT]   see Results.cpp
+ *   ./bench <affinity> sweep [plan...] [options]                see Sweep.cpp
+ *
+ * A filter is a shell pattern on the benchmark name, a leading '-' excludes.
+ * Without filters every benchmark runs. Options:
+ *   --repeat N            run every point N times
+ *   --set name=value      override a default
+ *   --sweep name=a,b,c    one point per value
+ *   --sweep name=lo..hi   lo, 2*lo, 4*lo, ... up to hi
+ *   --config a,b,c        run on these enclave configs instead of the default
+ *   --ci PCT              target CI half-width in % of the mean
+ *   --budget SEC          time budget per measurement
+ *   --min-trials N, --max-trials N, --max-warmup N
+ *   --output FILE         also write every result to FILE (.csv or JSON lines)
+ * Sweeps multiply, a benchmark only takes the ones on its own parameters.
+ */
+
+#include <algorithm>
+#include <fnmatch.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "sgx_urts.h"
+#include "../App.h"
+#include "Enclave_u.h"
+#include "rpc_ring.h"
+
+#define BENCH_MAX_PARAMS 6
+
+#define BENCH_ENCLAVE_NONE       0 /* the benchmark loads its own enclaves */
+#define BENCH_ENCLAVE_CLASSIC    1
+#define BENCH_ENCLAVE_SWITCHLESS 2 /* takes the uworkers / tworkers parameters */
+
+typedef struct _bench_param_t {
+    const char* name;
+    const char* def;
+    const char* help;
+} bench_param_t;
+
+struct _bench_desc_t;
+
+typedef struct _bench_args_t {
+    const struct _bench_desc_t* desc;
+    const char* config;  /* enclave config of this run */
+    const char* values[BENCH_MAX_PARAMS];
+} bench_args_t;
+
+/* returns 0 on success, -1 on invalid parameters or failure */
+typedef int (*bench_fn_t)(const bench_args_t* args);
+
+typedef struct _bench_desc_t {
+    const char* name;
+    const char* config;  /* default, Enclave/<config>-Enclave.config.xml */
+    int enclave;
+    bench_fn_t run;
+    const char* help;
+    bench_param_t params[BENCH_MAX_PARAMS];
+} bench_desc_t;
+
+static int bench_param_index(const bench_desc_t* desc, const char* name)
+{
+    for (int p = 0; p < BENCH_MAX_PARAMS && desc->params[p].name; ++p) {
+        if (strcmp(desc->params[p].name, name) == 0)
+            return p;
+    }
+    return -1;
+}
+
+static const char* bench_arg(const bench_args_t* args, const char* name)
+{
+    int p = bench_param_index(args->desc, name);
+    if (p < 0) {
+        printf("Error: [%s] has no parameter '%s'\n", args->desc->name, name);
+        abort();
+    }
+    return args->values[p];
+}
+
+static long bench_arg_long(const bench_args_t* args, const char* name)
+{
+    return strtol(bench_arg(args, name), NULL, 0);
+}
+
+static unsigned long bench_arg_ulong(const bench_args_t* args, const char* name)
+{
+    return strtoul(bench_arg(args, name), NULL, 0);
+}
+
+static int run_switching(const bench_args_t* a)
+{
+    switching_benchmark(bench_arg_ulong(a, "loops"), (int)bench_arg_long(a, "len"));
+    return 0;
+}
+
+static int run_switchless(const bench_args_t* a)
+{
+    long callers = bench_arg_long(a, "callers");
+    if (callers < 1) {
+        printf("Error: callers should be at least 1\n");
+        return -1;
+    }
+    printf("Info: switchless uworkers: %lu, tworkers: %lu\n", bench_arg_ulong(a, "uworkers"), bench_arg_ulong(a, "tworkers"));
+    switchless_benchmark(bench_arg_ulong(a, "loops"), (int)bench_arg_long(a, "len"), (int)callers);
+    return 0;
+}
+
+static int run_payload_sweep(const bench_args_t* a)
+{
+    payload_sweep_benchmark(bench_arg_ulong(a, "loops"), bench_arg_long(a, "max_bytes"));
+    return 0;
+}
+
+static int run_user_check(const bench_args_t* a)
+{
+    user_check_benchmark(bench_arg_ulong(a, "loops"), bench_arg_long(a, "max_bytes"));
+    return 0;
+}
+
+static int run_ecall_scaling(const bench_args_t* a)
+{
+    ecall_scaling_benchmark((int)bench_arg_long(a, "max_threads"), bench_arg(a, "cpu_list"),
+                            bench_arg_ulong(a, "loops"), (int)bench_arg_long(a, "len"));
+    return 0;
+}
+
+static int run_nested(const bench_args_t* a)
+{
+    nested_benchmark(bench_arg_ulong(a, "loops"), (int)bench_arg_long(a, "max_depth"), (int)bench_arg_long(a, "len"));
+    return 0;
+}
+
+static int run_batch(const bench_args_t* a)
+{
+    batch_benchmark(bench_arg_ulong(a, "loops"), (int)bench_arg_long(a, "max_batch"));
+    return 0;
+}
+
+static int run_rpc(const bench_args_t* a)
+{
+    int policy = rpc_policy_from_name(bench_arg(a, "policy"));
+    if (policy < 0) {
+        printf("Error: rpc policy should be 'spin', 'pause' or 'futex'\n");
+        return -1;
+    }
+    long callers = bench_arg_long(a, "callers");
+    if (callers < 1) {
+        printf("Error: callers should be at least 1\n");
+        return -1;
+    }
+    rpc_benchmark(bench_arg_ulong(a, "loops"), (int)bench_arg_long(a, "workers"), policy, (int)bench_arg_long(a, "len"),
+                  (int)callers);
+    return 0;
+}
+
+static int run_async(const bench_args_t* a)
+{
+    long ntasks = bench_arg_long(a, "tasks");
+    if (ntasks < 1 || ntasks > 256) {
+        printf("Error: async tasks should be in [1, 256]\n");
+        return -1;
+    }
+    async_benchmark((int)bench_arg_long(a, "steps"), (int)bench_arg_long(a, "workers"), (int)ntasks,
+                    strtoull(bench_arg(a, "io_cycles"), NULL, 0));
+    return 0;
+}
+
+static int run_memory_management(const bench_args_t* a)
+{
+    memory_management_benchmark((int)bench_arg_long(a, "page_num"), (int)bench_arg_long(a, "num"));
+    return 0;
+}
+
+static int run_memory_access(const bench_args_t* a)
+{
+    long block_size = bench_arg_long(a, "block_size");
+    if (block_size != 1 && block_size != 4 && block_size != 8 && block_size != 16 && block_size != 32 && block_size != 64) {
+        printf("Error: block_size should be 1, 4, 8, 16, 32 or 64\n");
+        return -1;
+    }
+    memory_access_benchmark((int)block_size);
+    return 0;
+}
+
+static int run_stream(const bench_args_t* a)
+{
+    return stream_benchmark(bench_arg_long(a, "array_mb"), (int)bench_arg_long(a, "passes"), bench_arg(a, "isa"));
+}
+
+static int run_heap_growth(const bench_args_t* a)
+{
+    return heap_growth_benchmark(a->config, bench_arg(a, "sizes"), bench_arg_long(a, "total_mb"));
+}
+
+static int run_stack_growth(const bench_args_t* a)
+{
+    return stack_growth_benchmark(a->config, bench_arg(a, "depths"), (int)bench_arg_long(a, "pool"),
+                                  bench_arg_long(a, "min_kb"));
+}
+
+static int run_tcs_create(const bench_args_t* a)
+{
+    return tcs_create_benchmark(a->config, bench_arg(a, "bursts"), (int)bench_arg_long(a, "pool"),
+                                (int)bench_arg_long(a, "rounds"));
+}
+
+static int run_edmm_scaling(const bench_args_t* a)
+{
+    long page_num = bench_arg_long(a, "page_num");
+    long max_threads = bench_arg_long(a, "max_threads");
+    long busy = bench_arg_long(a, "busy");
+    if (page_num < 1 || max_threads < 1 || busy < 0) {
+        printf("Error: edmm_scaling needs page_num >= 1, max_threads >= 1 and busy >= 0\n");
+        return -1;
+    }
+    edmm_scaling_benchmark((int)page_num, (int)bench_arg_long(a, "iterations"), (int)max_threads, (int)busy,
+                           bench_arg(a, "cpu_list"));
+    return 0;
+}
+
+static int run_epc_sweep(const bench_args_t* a)
+{
+    double factor = atof(bench_arg(a, "factor"));
+    if (bench_arg_long(a, "accesses") < 1 || factor <= 1.0) {
+        printf("Error: epc_sweep needs accesses >= 1 and factor > 1\n");
+        return -1;
+    }
+    epc_benchmark(bench_arg_long(a, "accesses"), bench_arg_long(a, "max_mb"), factor);
+    return 0;
+}
+
+static int run_alloc(const bench_args_t* a)
+{
+    long min_size = bench_arg_long(a, "min_size");
+    long max_size = bench_arg_long(a, "max_size");
+    if (min_size < 1 || max_size < min_size || max_size > 2048) {
+        printf("Error: alloc sizes should be 1 <= min_size <= max_size <= 2048\n");
+        return -1;
+    }
+    if (bench_arg_long(a, "objects") < 2) {
+        printf("Error: alloc needs at least 2 objects\n");
+        return -1;
+    }
+    alloc_benchmark(min_size, max_size, (int)bench_arg_long(a, "max_threads"), bench_arg(a, "cpu_list"),
+                    (int)bench_arg_long(a, "objects"), (int)bench_arg_long(a, "rounds"));
+    return 0;
+}
+
+static int run_malloc(const bench_args_t* a)
+{
+    long min_size = bench_arg_long(a, "min_size");
+    long max_size = bench_arg_long(a, "max_size");
+    if (min_size < 16 || max_size < min_size || bench_arg_long(a, "realloc_max") < 16) {
+        printf("Error: malloc sizes should be 16 <= min_size <= max_size and realloc_max >= 16\n");
+        return -1;
+    }
+    malloc_benchmark(min_size, max_size, bench_arg_long(a, "realloc_max"), (int)bench_arg_long(a, "max_threads"),
+                     bench_arg(a, "cpu_list"), bench_arg_long(a, "ops"));
+    return 0;
+}
+
+static int run_create_enclave(const bench_args_t* a)
+{
+    return create_enclave_benchmark(a->config, (int)bench_arg_long(a, "loops"));
+}
+
+static const bench_desc_t bench_registry[] = {
+    { "switching", "default", BENCH_ENCLAVE_CLASSIC, run_switching,
+      "ECALL / OCALL latency distribution",
+      { { "len", "128", "payload in longs" }, { "loops", "100000", "calls per trial" } } },
+    { "switchless", "switchless", BENCH_ENCLAVE_SWITCHLESS, run_switchless,
+      "classic vs switchless calls",
+      { { "uworkers", "1", "untrusted workers" }, { "tworkers", "1", "trusted workers" },
+        { "len", "128", "payload in longs" }, { "loops", "100000", "calls per trial" },
+        { "callers", "4", "threads calling at once for throughput, + tworkers <= TCSNum" } } },
+    { "payload_sweep", "default", BENCH_ENCLAVE_CLASSIC, run_payload_sweep,
+      "[in] / [out] / [in,out] marshaling cost by size",
+      { { "max_bytes", "67108864", "largest payload" }, { "loops", "10000", "most calls per trial" } } },
+    { "user_check", "default", BENCH_ENCLAVE_CLASSIC, run_user_check,
+      "[user_check] vs copied buffers",
+      { { "max_bytes", "67108864", "largest payload" }, { "loops", "10000", "most calls per trial" } } },
+    { "ecall_scaling", "scaling-tcs0", BENCH_ENCLAVE_CLASSIC, run_ecall_scaling,
+      "ECALL throughput with 1..max_threads threads",
+      { { "max_threads", "8", "at most TCSNum" }, { "cpu_list", "", "e.g. 0,2,4-7" },
+        { "len", "128", "payload in longs" }, { "loops", "100000", "calls per thread and trial" } } },
+    { "nested", "default", BENCH_ENCLAVE_CLASSIC, run_nested,
+      "nested OCALL -> ECALL re-entrancy",
+      { { "max_depth", "8", "deepest nesting" }, { "len", "1024", "payload in longs" },
+        { "loops", "10000", "calls per trial" } } },
+    { "batch", "default", BENCH_ENCLAVE_CLASSIC, run_batch,
+      "batched commands vs one ECALL each",
+      { { "max_batch", "4096", "largest batch" }, { "loops", "100000", "commands per trial" } } },
+    { "rpc", "scaling-tcs1", BENCH_ENCLAVE_CLASSIC, run_rpc,
+      "exitless RPC vs OCALL",
+      { { "workers", "1", "host workers" }, { "policy", "pause", "spin / pause / futex" },
+        { "len", "128", "payload in longs" }, { "loops", "100000", "calls per trial" },
+        { "callers", "4", "enclave threads calling at once for throughput, <= TCSNum" } } },
+    { "async", "default", BENCH_ENCLAVE_CLASSIC, run_async,
+      "async OCALL overlap with compute",
+      { { "workers", "4", "host workers" }, { "tasks", "16", "concurrent tasks, <= 256" },
+        { "io_cycles", "20000", "cycles per IO" }, { "steps", "200", "steps per task and trial" } } },
+    { "memory_management", "default", BENCH_ENCLAVE_CLASSIC, run_memory_management,
+      "EDMM vs mmap / mprotect / munmap / sbrk",
+      { { "page_num", "1", "pages per block" }, { "num", "100", "blocks" } } },
+    { "memory_access", "mem-access", BENCH_ENCLAVE_CLASSIC, run_memory_access,
+      "EPC vs untrusted memory access",
+      { { "block_size", "64", "bytes per access: 1, 4, 8, 16, 32 or 64" } } },
+    { "stream", "mem-access", BENCH_ENCLAVE_CLASSIC, run_stream,
+      "STREAM copy / scale / add / triad bandwidth, EPC vs untrusted",
+      { { "array_mb", "64", "MB per array, 3 arrays" }, { "passes", "10", "per kernel, the first one warms up" },
+        { "isa", "auto", "auto, sse2, avx2 or avx512" } } },
+    { "heap_growth", "heap-grow", BENCH_ENCLAVE_NONE, run_heap_growth,
+      "malloc latency while the heap grows from HeapMinSize",
+      { { "sizes", "64,4096,1048576", "object sizes" }, { "total_mb", "128", "allocated per size, < HeapMaxSize" } } },
+    { "stack_growth", "config.04", BENCH_ENCLAVE_NONE, run_stack_growth,
+      "first touch of stack pages of a thread on a new TCS",
+      { { "depths", "16,64,128,192", "KB, < StackMaxSize" }, { "pool", "3", "threads parked first, TCSMinPool" },
+        { "min_kb", "8", "StackMinSize, not counted as growth" } } },
+    { "tcs_create", "tcs-create", BENCH_ENCLAVE_NONE, run_tcs_create,
+      "first ecall of threads that need a TCS added at run time",
+      { { "bursts", "2,4,8", "threads entering at once" }, { "pool", "1", "threads parked first, TCSNum = TCSMinPool" },
+        { "rounds", "10", "enclave loads per burst" } } },
+    { "edmm_scaling", "scaling-tcs0", BENCH_ENCLAVE_CLASSIC, run_edmm_scaling,
+      "EDMM alloc / touch / restrict / free on K threads, others running",
+      { { "page_num", "16", "pages per block" }, { "iterations", "200", "blocks per worker" },
+        { "max_threads", "8", "most workers, + busy <= TCSNum" }, { "busy", "2", "threads spinning in the enclave" },
+        { "cpu_list", "", "e.g. 0,2,4-7" } } },
+    { "epc_sweep", "epc", BENCH_ENCLAVE_CLASSIC, run_epc_sweep,
+      "paging knee and page swap cost around the EPC size",
+      { { "accesses", "65536", "page touches per trial" }, { "max_mb", "0", "largest buffer, 0: 2x EPC" },
+        { "factor", "2", "knee: touches this much slower than in the EPC" } } },
+    { "alloc", "scaling-tcs0", BENCH_ENCLAVE_CLASSIC, run_alloc,
+      "slab allocator vs tlibc malloc vs sbrk",
+      { { "min_size", "16", "smallest object" }, { "max_size", "2048", "largest object, <= 2048" },
+        { "max_threads", "8", "at most TCSNum" }, { "cpu_list", "", "e.g. 0,2,4-7" },
+        { "objects", "1024", "objects per thread and round" }, { "rounds", "10", "rounds per thread and trial" } } },
+    { "malloc", "scaling-tcs0", BENCH_ENCLAVE_CLASSIC, run_malloc,
+      "tlibc malloc in the enclave vs glibc on the host",
+      { { "min_size", "16", "smallest object" }, { "max_size", "4096", "largest object" },
+        { "realloc_max", "65536", "realloc growth limit" }, { "max_threads", "4", "at most TCSNum" },
+        { "cpu_list", "", "e.g. 0,2,4-7" }, { "ops", "100000", "ops per thread and trial" } } },
+    { "create_enclave", "default", BENCH_ENCLAVE_NONE, run_create_enclave,
+      "enclave load time",
+      { { "loops", "1", "enclaves created per trial" } } },
+};
+
+#define BENCH_COUNT ((int)(sizeof(bench_registry) / sizeof(bench_registry[0])))
+
+static const bench_desc_t* bench_find(const char* name)
+{
+    for (int b = 0; b < BENCH_COUNT; ++b) {
+        if (strcmp(bench_registry[b].name, name) == 0)
+            return &bench_registry[b];
+    }
+    return NULL;
+}
+
+static void bench_list(void)
+{
+    for (int b = 0; b < BENCH_COUNT; ++b) {
+        const bench_desc_t* desc = &bench_registry[b];
+        printf("%-20s %s (config: %s)\n", desc->name, desc->help, desc->config);
+        for (int p = 0; p < BENCH_MAX_PARAMS && desc->params[p].name; ++p)
+            printf("    %-16s default '%s', %s\n", desc->params[p].name, desc->params[p].def, desc->params[p].help);
+    }
+}
+
+/* The enclave currently loaded for the runs */
+static int loaded_kind = BENCH_ENCLAVE_NONE;
+static std::string loaded_config;
+static unsigned long loaded_uworkers = 0;
+static unsigned long loaded_tworkers = 0;
+
+void bench_enclave_release(void)
+{
+    if (loaded_kind != BENCH_ENCLAVE_NONE)
+        sgx_destroy_enclave(global_eid);
+    loaded_kind = BENCH_ENCLAVE_NONE;
+}
+
+/* Load the enclave args need, unless it is loaded already */
+static int bench_enclave_acquire(const bench_args_t* args)
+{
+    int kind = args->desc->enclave;
+    unsigned long uworkers = 0, tworkers = 0;
+    if (kind == BENCH_ENCLAVE_SWITCHLESS) {
+        uworkers = bench_arg_ulong(args, "uworkers");
+        tworkers = bench_arg_ulong(args, "tworkers");
+    }
+    if (kind == loaded_kind && loaded_config == args->config &&
+        uworkers == loaded_uworkers && tworkers == loaded_tworkers)
+        return 0;
+
+    bench_enclave_release();
+    if (kind == BENCH_ENCLAVE_CLASSIC) {
+        if (initialize_enclave(args->config) < 0) {
+            printf("Error: initialize_enclave failed\n");
+            return -1;
+        }
+    } else if (kind == BENCH_ENCLAVE_SWITCHLESS) {
+        if (initialize_switchless_enclave(args->config, (unsigned int)uworkers, (unsigned int)tworkers) < 0) {
+            printf("Error: initialize_switchless_enclave failed\n");
+            return -1;
+        }
+    }
+    loaded_kind = kind;
+    loaded_config = args->config;
+    loaded_uworkers = uworkers;
+    loaded_tworkers = tworkers;
+    return 0;
+}
+
+static int bench_run_one(const bench_args_t* args, int rep, int repeat)
+{
+    const bench_desc_t* desc = args->desc;
+    std::string params;
+    for (int p = 0; p < BENCH_MAX_PARAMS && desc->params[p].name; ++p)
+        params += std::string(p ? " " : "") + desc->params[p].name + "=" + args->values[p];
+    printf("==> %s %s [config: %s, run %d/%d]\n", desc->name, params.c_str(), args->config, rep + 1, repeat);
+    results_begin(desc->name, args->config, params.c_str());
+
+    if (bench_enclave_acquire(args) < 0)
+        return -1;
+    return desc->run(args);
+}
+
+/* bench_run_with:
+ *   Run benchmark name once, set holds "param=value" overrides of its
+ *   defaults. The enclave stays loaded for the next run.
+ */
+int bench_run_with(const char* name, int nset, const char* set[])
+{
+    const bench_desc_t* desc = bench_find(name);
+    std::vector<std::string> values(nset);
+    bench_args_t args;
+
+    if (desc == NULL) {
+        printf("Error: unknown bench type '%s'\n", name);
+        return -1;
+    }
+    args.desc = desc;
+    args.config = desc->config;
+    for (int p = 0; p < BENCH_MAX_PARAMS; ++p)
+        args.values[p] = desc->params[p].name ? desc->params[p].def : NULL;
+    for (int i = 0; i < nset; ++i) {
+        const char* eq = strchr(set[i], '=');
+        int p = eq ? bench_param_index(desc, std::string(set[i], eq - set[i]).c_str()) : -1;
+        if (p < 0) {
+            printf("Error: [%s] has no parameter '%s'\n", name, set[i]);
+            return -1;
+        }
+        values[i] = eq + 1;
+        args.values[p] = values[i].c_str();
+    }
+    return bench_run_one(&args, 0, 1);
+}
+
+/* bench_enclave_reset:
+ *   Bring the loaded enclave back to its initial memory state between runs,
+ *   or release it (the next run reloads it) if that fails. Returns 1 when
+ *   the enclave was released.
+ */
+int bench_enclave_reset(void)
+{
+    int dirty = 0;
+    if (loaded_kind == BENCH_ENCLAVE_NONE)
+        return 0;
+    if (ecall_memory_state_reset(global_eid, &dirty) != SGX_SUCCESS || dirty) {
+        printf("Info: enclave memory state not restored, reloading the enclave\n");
+        bench_enclave_release();
+        return 1;
+    }
+    return 0;
+}
+
+/* "a,b,c" -> values, split on commas only */
+static void bench_split_list(const char* spec, std::vector<std::string>* values)
+{
+    std::string s(spec);
+    size_t start = 0;
+    for (;;) {
+        size_t comma = s.find(',', start);
+        values->push_back(s.substr(start, comma == std::string::npos ? std::string::npos : comma - start));
+        if (comma == std::string::npos)
+            break;
+        start = comma + 1;
+    }
+}
+
+/* "a,b,c" or "lo..hi" (doubling) -> values */
+static int bench_parse_sweep(const char* spec, std::vector<std::string>* values)
+{
+    const char* dots = strstr(spec, "..");
+    if (dots != NULL) {
+        char* end = NULL;
+        unsigned long lo = strtoul(spec, &end, 0);
+        unsigned long hi = strtoul(dots + 2, NULL, 0);
+        if (end != dots || lo == 0 || hi < lo)
+            return -1;
+        for (unsigned long v = lo; v <= hi; v *= 2)
+            values->push_back(std::to_string(v));
+        return 0;
+    }
+    bench_split_list(spec, values);
+    return 0;
+}
+
+struct bench_sweep_t {
+    std::string name;
+    std::vector<std::string> values;
+};
+
+static int bench_selected(const bench_desc_t* desc, const std::vector<std::string>& filters)
+{
+    int included = 1;
+    for (size_t f = 0; f < filters.size(); ++f) {
+        if (filters[f][0] != '-') {
+            included = 0;
+            break;
+        }
+    }
+    for (size_t f = 0; f < filters.size(); ++f) {
+        const char* pattern = filters[f].c_str();
+        if (pattern[0] == '-') {
+            if (fnmatch(pattern + 1, desc->name, 0) == 0)
+                return 0;
+        } else if (fnmatch(pattern, desc->name, 0) == 0) {
+            included = 1;
+        }
+    }
+    return included;
+}
+
+static int bench_run_cli(int argc, char* argv[])
+{
+    std::vector<std::string> filters;
+    std::vector<bench_sweep_t> sweeps;
+    std::vector<std::string> configs;
+    const char* output = NULL;
+    int repeat = 1;
+
+    for (int i = 0; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (strcmp(arg, "--repeat") == 0 && i + 1 < argc) {
+            repeat = atoi(argv[++i]);
+            if (repeat < 1) {
+                printf("Error: --repeat should be at least 1\n");
+                return -1;
+            }
+        } else if (strcmp(arg, "--output") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (strcmp(arg, "--config") == 0 && i + 1 < argc) {
+            /* config names are file names, ".." is not a range there */
+            bench_split_list(argv[++i], &configs);
+            if (std::find(configs.begin(), configs.end(), std::string()) != configs.end()) {
+                printf("Error: bad config list '%s'\n", argv[i]);
+                return -1;
+            }
+        } else if (strcmp(arg, "--ci") == 0 && i + 1 < argc) {
+            stats_config.ci_target = atof(argv[++i]) / 100.0;
+        } else if (strcmp(arg, "--budget") == 0 && i + 1 < argc) {
+            stats_config.budget_sec = atof(argv[++i]);
+        } else if (strcmp(arg, "--min-trials") == 0 && i + 1 < argc) {
+            stats_config.min_trials = atoi(argv[++i]);
+        } else if (strcmp(arg, "--max-trials") == 0 && i + 1 < argc) {
+            stats_config.max_trials = atoi(argv[++i]);
+        } else if (strcmp(arg, "--max-warmup") == 0 && i + 1 < argc) {
+            stats_config.max_warmup = atoi(argv[++i]);
+        } else if ((strcmp(arg, "--set") == 0 || strcmp(arg, "--sweep") == 0) && i + 1 < argc) {
+            const char* spec = argv[++i];
+            const char* eq = strchr(spec, '=');
+            bench_sweep_t sweep;
+            if (eq == NULL || eq == spec) {
+                printf("Error: %s expects name=value, got '%s'\n", arg, spec);
+                return -1;
+            }
+            sweep.name.assign(spec, eq - spec);
+            if (strcmp(arg, "--set") == 0)
+                sweep.values.push_back(eq + 1);
+            else if (bench_parse_sweep(eq + 1, &sweep.values) < 0) {
+                printf("Error: bad sweep '%s'\n", spec);
+                return -1;
+            }
+            sweeps.push_back(sweep);
+        } else if (strncmp(arg, "--", 2) == 0) {
+            printf("Error: unknown option '%s'\n", arg);
+            return -1;
+        } else {
+            filters.push_back(arg);
+        }
+    }
+
+    if (stats_config.min_trials < 2 || stats_config.max_trials < stats_config.min_trials ||
+        stats_config.ci_target <= 0.0 || stats_config.budget_sec <= 0.0 || stats_config.max_warmup < 0) {
+        printf("Error: need 2 <= min-trials <= max-trials, ci > 0, budget > 0, max-warmup >= 0\n");
+        return -1;
+    }
+
+    std::vector<const bench_desc_t*> selected;
+    for (int b = 0; b < BENCH_COUNT; ++b) {
+        if (bench_selected(&bench_registry[b], filters))
+            selected.push_back(&bench_registry[b]);
+    }
+    if (selected.empty()) {
+        printf("Error: no benchmark matches the filters, see './bench <affinity> list'\n");
+        return -1;
+    }
+    for (size_t s = 0; s < sweeps.size(); ++s) {
+        int used = 0;
+        for (size_t b = 0; b < selected.size(); ++b)
+            used |= bench_param_index(selected[b], sweeps[s].name.c_str()) >= 0;
+        if (!used) {
+            printf("Error: no selected benchmark has a parameter '%s'\n", sweeps[s].name.c_str());
+            return -1;
+        }
+    }
+
+    if (output != NULL && results_open(output, 0) < 0)
+        return -1;
+
+    int failures = 0;
+    for (size_t b = 0; b < selected.size(); ++b) {
+        const bench_desc_t* desc = selected[b];
+
+        /* sweeps on this benchmark's parameters, later ones win on conflicts */
+        std::vector<const bench_sweep_t*> mine;
+        std::vector<int> slots;
+        for (size_t s = 0; s < sweeps.size(); ++s) {
+            int p = bench_param_index(desc, sweeps[s].name.c_str());
+            if (p >= 0) {
+                mine.push_back(&sweeps[s]);
+                slots.push_back(p);
+            }
+        }
+
+        std::vector<size_t> odometer(mine.size(), 0);
+        for (;;) {
+            bench_args_t args;
+            args.desc = desc;
+            for (int p = 0; p < BENCH_MAX_PARAMS; ++p)
+                args.values[p] = desc->params[p].name ? desc->params[p].def : NULL;
+            for (size_t s = 0; s < mine.size(); ++s)
+                args.values[slots[s]] = mine[s]->values[odometer[s]].c_str();
+
+            /* configs innermost, so runs on different configs sit side by side */
+            for (size_t c = 0; c < (configs.empty() ? 1 : configs.size()); ++c) {
+                args.config = configs.empty() ? desc->config : configs[c].c_str();
+                for (int rep = 0; rep < repeat; ++rep) {
+                    if (bench_run_one(&args, rep, repeat) < 0)
+                        failures++;
+                }
+            }
+
+            size_t s = 0;
+            while (s < mine.size() && ++odometer[s] == mine[s]->values.size())
+                odometer[s++] = 0;
+            if (s == mine.size())
+                break;
+        }
+    }
+
+    bench_enclave_release();
+    results_close();
+    if (failures)
+        printf("Error: %d run(s) failed\n", failures);
+    return failures ? -1 : 0;
+}
+
+/* bench_main:
+ *   argv[0] is the command or benchmark name (after the affinity).
+ */
+int bench_main(int argc, char* argv[])
+{
+    if (strcmp(argv[0], "list") == 0) {
+        bench_list();
+        return 0;
+    }
+    if (strcmp(argv[0], "run") == 0)
+        return bench_run_cli(argc - 1, argv + 1);
+    if (strcmp(argv[0], "compare") == 0)
+        return results_compare(argc - 1, argv + 1);
+    if (strcmp(argv[0], "sweep") == 0)
+        return sweep_main(argc - 1, argv + 1);
+
+    const bench_desc_t* desc = bench_find(argv[0]);
+    if (desc == NULL) {
+        printf("Error: unknown bench type '%s', see './bench <affinity> list'\n", argv[0]);
+        return -1;
+    }
+
+    /* legacy form: positional values in parameter order */
+    bench_args_t args;
+    args.desc = desc;
+    args.config = desc->config;
+    int nparams = 0;
+    for (int p = 0; p < BENCH_MAX_PARAMS; ++p) {
+        args.values[p] = desc->params[p].name ? desc->params[p].def : NULL;
+        if (desc->params[p].name)
+            nparams++;
+    }
+    if (argc - 1 > nparams) {
+        printf("Error: [%s] takes at most %d parameters\n", desc->name, nparams);
+        return -1;
+    }
+    for (int i = 1; i < argc; ++i)
+        args.values[i - 1] = argv[i];
+
+    int ret = bench_run_one(&args, 0, 1);
+    bench_enclave_release();
+    return ret;
+}
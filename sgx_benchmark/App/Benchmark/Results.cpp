@@ -0,0 +1,612 @@
+/* Results.cpp - machine-readable results and baseline comparison.
+ *
+ * With `run --output FILE` every measurement is also written to FILE as one
+ * record, JSON lines by default or CSV when FILE ends in ".csv". A record
+ * carries the benchmark, its parameters, the case, the statistics and where
+ * it ran: host, kernel, CPU model, microcode, SGX SDK version, enclave config
+ * and the hash of its config XML.
+ *
+ *   ./bench <affinity> compare BASE CURRENT [--threshold PCT] [--across-configs]
+ *
+ * matches the records of two result files (either format) by benchmark,
+ * config, parameters and case, or without the config with --across-configs
+ * (e.g. one file per config). A change is flagged when it is statistically
+ * significant (Welch's t-test, 95%) and larger than the threshold (default
+ * 2%). Records repeated in one file (--repeat) are pooled. The command
+ * returns 1 when it found a regression.
+ */
+
+#include <map>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/utsname.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "../App.h"
+#include "Enclave_u.h"
+
+#ifndef SGX_SDK_VERSION
+#define SGX_SDK_VERSION ""
+#endif
+
+typedef std::map<std::string, std::string> result_record_t;
+
+struct result_field_t {
+    const char* name;
+    int numeric;
+};
+
+static const result_field_t result_fields[] = {
+    { "benchmark", 0 }, { "params", 0 }, { "case", 0 }, { "unit", 0 },
+    { "mean", 1 }, { "ci", 1 }, { "stddev", 1 }, { "trials", 1 }, { "outliers", 1 },
+    { "warmup", 1 }, { "converged", 1 },
+    { "host", 0 }, { "kernel", 0 }, { "cpu", 0 }, { "microcode", 0 }, { "tsc_hz", 1 },
+    { "sdk", 0 }, { "config", 0 }, { "config_hash", 0 }, { "time", 1 },
+};
+
+#define RESULT_NFIELDS ((int)(sizeof(result_fields) / sizeof(result_fields[0])))
+
+/* fields that must match for two result files to be comparable as is */
+static const char* result_env_fields[] = { "host", "kernel", "cpu", "microcode", "tsc_hz", "sdk" };
+
+static FILE* results_file = NULL;
+static int results_csv = 0;
+static result_record_t results_context;  /* shared by the records of a run */
+static int results_deferred = 0;
+static std::vector<result_record_t> results_pending;
+
+static std::string trim(const char* s)
+{
+    const char* end = s + strlen(s);
+    while (*s == ' ' || *s == '\t')
+        s++;
+    while (end > s && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\n' || end[-1] == '\r'))
+        end--;
+    return std::string(s, end - s);
+}
+
+/* Value of the first "key : value" line of /proc/cpuinfo */
+static std::string cpuinfo_field(const char* key)
+{
+    FILE* f = fopen("/proc/cpuinfo", "r");
+    std::string value;
+    char line[512];
+    size_t len = strlen(key);
+    if (f == NULL)
+        return value;
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, key, len) != 0 || (line[len] != ' ' && line[len] != '\t' && line[len] != ':'))
+            continue;
+        const char* colon = strchr(line, ':');
+        if (colon != NULL)
+            value = trim(colon + 1);
+        break;
+    }
+    fclose(f);
+    return value;
+}
+
+/* FNV-1a of a file, "" if it cannot be read */
+static std::string file_hash(const char* path)
+{
+    FILE* f = fopen(path, "rb");
+    uint64_t hash = 0xcbf29ce484222325ull;
+    char buf[32];
+    int c;
+    if (f == NULL)
+        return "";
+    while ((c = fgetc(f)) != EOF)
+        hash = (hash ^ (uint8_t)c) * 0x100000001b3ull;
+    fclose(f);
+    snprintf(buf, sizeof(buf), "%016lx", (unsigned long)hash);
+    return buf;
+}
+
+/* Directory of the bench executable, "." if unknown */
+static std::string exe_dir(void)
+{
+    char path[4096];
+    ssize_t len = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if (len <= 0)
+        return ".";
+    path[len] = '\0';
+    char* slash = strrchr(path, '/');
+    if (slash == NULL)
+        return ".";
+    *slash = '\0';
+    return path[0] ? path : "/";
+}
+
+/* Hash of Enclave/<config>-Enclave.config.xml or Enclave/<config>.xml next
+ * to the executable, so it does not depend on the working directory. Looked
+ * up once per config, with a warning when neither file is there.
+ */
+static std::string config_hash(const char* config)
+{
+    static std::map<std::string, std::string> hashes;
+    std::map<std::string, std::string>::iterator it = hashes.find(config);
+    if (it != hashes.end())
+        return it->second;
+
+    std::string dir = exe_dir() + "/Enclave/";
+    std::string hash = file_hash((dir + config + "-Enclave.config.xml").c_str());
+    if (hash.empty())
+        hash = file_hash((dir + config + ".xml").c_str());
+    if (hash.empty())
+        printf("Info: no config file for %s in %s, its records have no config_hash\n", config, dir.c_str());
+    hashes[config] = hash;
+    return hash;
+}
+
+static void write_json_string(FILE* f, const std::string& s)
+{
+    fputc('"', f);
+    for (size_t i = 0; i < s.size(); ++i) {
+        unsigned char c = (unsigned char)s[i];
+        if (c == '"' || c == '\\')
+            fprintf(f, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(f, "\\u%04x", c);
+        else
+            fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+static void write_csv_field(FILE* f, const std::string& s)
+{
+    fputc('"', f);
+    for (size_t i = 0; i < s.size(); ++i) {
+        if (s[i] == '"')
+            fputc('"', f);
+        fputc(s[i], f);
+    }
+    fputc('"', f);
+}
+
+static void results_write(const result_record_t& rec)
+{
+    if (!results_csv)
+        fputc('{', results_file);
+    for (int i = 0; i < RESULT_NFIELDS; ++i) {
+        result_record_t::const_iterator it = rec.find(result_fields[i].name);
+        std::string value = it == rec.end() ? "" : it->second;
+        if (i > 0)
+            fputs(results_csv ? "," : ", ", results_file);
+        if (results_csv) {
+            if (result_fields[i].numeric)
+                fputs(value.c_str(), results_file);
+            else
+                write_csv_field(results_file, value);
+        } else {
+            fprintf(results_file, "\"%s\": ", result_fields[i].name);
+            if (result_fields[i].numeric)
+                fputs(value.empty() ? "null" : value.c_str(), results_file);
+            else
+                write_json_string(results_file, value);
+        }
+    }
+    fputs(results_csv ? "\n" : "}\n", results_file);
+    fflush(results_file);
+}
+
+/* results_open:
+ *   Start writing records to path, CSV if it ends in ".csv", JSON lines
+ *   otherwise, after the records already there if append is set. Returns
+ *   -1 if the file cannot be opened.
+ */
+int results_open(const char* path, int append)
+{
+    size_t len = strlen(path);
+    results_csv = len >= 4 && strcmp(path + len - 4, ".csv") == 0;
+    results_file = fopen(path, append ? "a" : "w");
+    if (results_file == NULL) {
+        printf("Error: cannot create results file '%s'\n", path);
+        return -1;
+    }
+
+    struct utsname uts;
+    char buf[64];
+    if (uname(&uts) == 0) {
+        results_context["host"] = uts.nodename;
+        results_context["kernel"] = uts.release;
+    }
+    results_context["cpu"] = cpuinfo_field("model name");
+    results_context["microcode"] = cpuinfo_field("microcode");
+    snprintf(buf, sizeof(buf), "%lu", (unsigned long)timing.tsc_hz);
+    results_context["tsc_hz"] = buf;
+    results_context["sdk"] = SGX_SDK_VERSION;
+
+    fseek(results_file, 0, SEEK_END);
+    if (results_csv && ftell(results_file) == 0) {
+        for (int i = 0; i < RESULT_NFIELDS; ++i)
+            fprintf(results_file, "%s%s", i ? "," : "", result_fields[i].name);
+        fputc('\n', results_file);
+    }
+    return 0;
+}
+
+void results_close(void)
+{
+    if (results_file != NULL)
+        fclose(results_file);
+    results_file = NULL;
+}
+
+/* results_defer:
+ *   While on, records are held back until results_commit(), so that an
+ *   interrupted sweep point leaves none behind. Turning it off drops the
+ *   records not committed.
+ */
+void results_defer(int on)
+{
+    results_deferred = on;
+    results_pending.clear();
+}
+
+void results_commit(void)
+{
+    for (size_t i = 0; i < results_pending.size(); ++i)
+        results_write(results_pending[i]);
+    results_pending.clear();
+}
+
+/* results_begin:
+ *   Benchmark, enclave config and "name=value ..." parameters of the
+ *   records that follow.
+ */
+void results_begin(const char* bench, const char* config, const char* params)
+{
+    std::string hash = results_file != NULL ? config_hash(config) : "";
+    results_context["benchmark"] = bench;
+    results_context["config"] = config;
+    results_context["config_hash"] = hash;
+    results_context["params"] = params;
+}
+
+/* results_add:
+ *   One measurement of the current benchmark, name is its case as printed
+ *   (enclosing brackets are dropped). A unit ending in "/s" means higher
+ *   is better.
+ */
+void results_add(const char* name, const char* unit, const stats_result_t* stats)
+{
+    if (results_file == NULL)
+        return;
+
+    result_record_t rec = results_context;
+    std::string label(name);
+    char buf[64];
+    if (label.size() >= 2 && label[0] == '[' && label[label.size() - 1] == ']')
+        label = label.substr(1, label.size() - 2);
+    rec["case"] = label;
+    rec["unit"] = unit;
+    snprintf(buf, sizeof(buf), "%.6g", stats->mean);
+    rec["mean"] = buf;
+    snprintf(buf, sizeof(buf), "%.6g", stats->ci);
+    rec["ci"] = buf;
+    snprintf(buf, sizeof(buf), "%.6g", stats->stddev);
+    rec["stddev"] = buf;
+    rec["trials"] = std::to_string(stats->trials);
+    rec["outliers"] = std::to_string(stats->outliers);
+    rec["warmup"] = std::to_string(stats->warmup);
+    rec["converged"] = std::to_string(stats->converged);
+    rec["time"] = std::to_string((long)time(NULL));
+    if (results_deferred)
+        results_pending.push_back(rec);
+    else
+        results_write(rec);
+}
+
+/* Every recorded value of hist is one trial, divided by scale (the pages of
+ * a block, the operations of an iteration, ...)
+ */
+void results_add_hist(const char* name, const char* unit, const histogram_t* hist, double scale)
+{
+    stats_result_t stats;
+    memset(&stats, 0, sizeof(stats));
+    stats.mean = hist->count ? (double)hist->sum / (double)hist->count / scale : 0.0;
+    stats.ci = hist_ci95(hist) / scale;
+    stats.stddev = hist_stddev(hist) / scale;
+    stats.trials = (int)hist->count;
+    stats.converged = 1;
+    results_add(name, unit, &stats);
+}
+
+/* A single measurement without spread */
+void results_add_value(const char* name, const char* unit, double value)
+{
+    stats_result_t stats;
+    memset(&stats, 0, sizeof(stats));
+    stats.mean = value;
+    stats.trials = 1;
+    stats.converged = 1;
+    results_add(name, unit, &stats);
+}
+
+/* ocall_result_hist:
+ *   Records of measurements taken inside the enclave.
+ */
+void ocall_result_hist(const char* name, const char* unit, const histogram_t* hist, double scale)
+{
+    results_add_hist(name, unit, hist, scale);
+}
+
+/* Parse one flat JSON object of strings and numbers */
+static int parse_json_record(const char* p, result_record_t* rec)
+{
+    while (*p == ' ' || *p == '\t')
+        p++;
+    if (*p++ != '{')
+        return -1;
+    for (;;) {
+        std::string key, value;
+        std::string* out = &key;
+        for (int part = 0; part < 2; ++part, out = &value) {
+            while (*p == ' ' || *p == '\t')
+                p++;
+            if (*p == '"') {
+                for (p++; *p && *p != '"'; ++p) {
+                    if (*p != '\\') {
+                        out->push_back(*p);
+                        continue;
+                    }
+                    p++;
+                    if (*p == 'u' && strlen(p) >= 5) {
+                        out->push_back((char)strtol(std::string(p + 1, 4).c_str(), NULL, 16));
+                        p += 4;
+                    } else if (*p == 'n') {
+                        out->push_back('\n');
+                    } else if (*p == 't') {
+                        out->push_back('\t');
+                    } else if (*p) {
+                        out->push_back(*p);
+                    }
+                }
+                if (*p++ != '"')
+                    return -1;
+            } else if (part == 1) {
+                while (*p && *p != ',' && *p != '}' && *p != ' ')
+                    out->push_back(*p++);
+                if (*out == "null")
+                    out->clear();
+            } else {
+                return -1;
+            }
+            while (*p == ' ' || *p == '\t')
+                p++;
+            if (part == 0 && *p++ != ':')
+                return -1;
+        }
+        (*rec)[key] = value;
+        if (*p == '}')
+            return 0;
+        if (*p++ != ',')
+            return -1;
+    }
+}
+
+/* Split one CSV line, fields may be quoted with "" escapes */
+static std::vector<std::string> parse_csv_line(const char* p)
+{
+    std::vector<std::string> fields;
+    for (;;) {
+        std::string field;
+        if (*p == '"') {
+            for (p++; *p; ++p) {
+                if (*p == '"' && p[1] == '"')
+                    field.push_back(*p++);
+                else if (*p == '"')
+                    break;
+                else
+                    field.push_back(*p);
+            }
+            if (*p == '"')
+                p++;
+        }
+        while (*p && *p != ',' && *p != '\n' && *p != '\r')
+            field.push_back(*p++);
+        fields.push_back(field);
+        if (*p != ',')
+            return fields;
+        p++;
+    }
+}
+
+static int results_load(const char* path, std::vector<result_record_t>* records)
+{
+    FILE* f = fopen(path, "r");
+    std::vector<std::string> header;
+    std::string line;
+    char buf[4096];
+    int lineno = 0;
+
+    if (f == NULL) {
+        printf("Error: cannot open results file '%s'\n", path);
+        return -1;
+    }
+    while (fgets(buf, sizeof(buf), f)) {
+        line += buf;
+        if (line[line.size() - 1] != '\n' && !feof(f))
+            continue;
+        lineno++;
+        std::string text = trim(line.c_str());
+        line.clear();
+        if (text.empty())
+            continue;
+
+        result_record_t rec;
+        if (text[0] == '{') {
+            if (parse_json_record(text.c_str(), &rec) < 0) {
+                printf("Error: %s:%d is not a result record\n", path, lineno);
+                fclose(f);
+                return -1;
+            }
+        } else if (header.empty()) {
+            header = parse_csv_line(text.c_str());
+            continue;
+        } else {
+            std::vector<std::string> fields = parse_csv_line(text.c_str());
+            for (size_t i = 0; i < fields.size() && i < header.size(); ++i)
+                rec[header[i]] = fields[i];
+        }
+        records->push_back(rec);
+    }
+    fclose(f);
+    return 0;
+}
+
+/* Trials of all records of one case, pooled */
+struct result_pool_t {
+    result_record_t first;
+    double n;
+    double mean;
+    double m2;   /* sum of squared deviations from the mean */
+};
+
+static std::string result_field(const result_record_t& rec, const char* name)
+{
+    result_record_t::const_iterator it = rec.find(name);
+    return it == rec.end() ? "" : it->second;
+}
+
+static std::string result_key(const result_record_t& rec, int with_config)
+{
+    std::string key = result_field(rec, "benchmark");
+    if (with_config)
+        key += " [" + result_field(rec, "config") + "]";
+    return key + " " + result_field(rec, "params") + " | " + result_field(rec, "case");
+}
+
+static void pool_records(const std::vector<result_record_t>& records, int with_config,
+                         std::vector<std::string>* order, std::map<std::string, result_pool_t>* pools)
+{
+    for (size_t r = 0; r < records.size(); ++r) {
+        const result_record_t& rec = records[r];
+        std::string key = result_key(rec, with_config);
+        double n = atof(result_field(rec, "trials").c_str());
+        double mean = atof(result_field(rec, "mean").c_str());
+        double sd = atof(result_field(rec, "stddev").c_str());
+        if (n < 1)
+            n = 1;
+
+        std::map<std::string, result_pool_t>::iterator it = pools->find(key);
+        if (it == pools->end()) {
+            result_pool_t pool = { rec, n, mean, sd * sd * (n - 1) };
+            (*pools)[key] = pool;
+            order->push_back(key);
+            continue;
+        }
+        result_pool_t* pool = &it->second;
+        double total = pool->n + n;
+        double delta = mean - pool->mean;
+        pool->m2 += sd * sd * (n - 1) + delta * delta * pool->n * n / total;
+        pool->mean += delta * n / total;
+        pool->n = total;
+    }
+}
+
+/* variance of the pooled mean */
+static double pool_var_of_mean(const result_pool_t& p)
+{
+    return p.n > 1 ? p.m2 / (p.n - 1) / p.n : 0.0;
+}
+
+/* results_compare:
+ *   argv is BASE CURRENT [--threshold PCT] [--across-configs]. Returns 1 if
+ *   a regression was found, -1 on errors, 0 otherwise.
+ */
+int results_compare(int argc, char* argv[])
+{
+    double threshold = 0.02;
+    int with_config = 1;
+    std::vector<const char*> paths;
+    for (int i = 0; i < argc; ++i) {
+        if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+            threshold = atof(argv[++i]) / 100.0;
+        else if (strcmp(argv[i], "--across-configs") == 0)
+            with_config = 0;
+        else
+            paths.push_back(argv[i]);
+    }
+    if (paths.size() != 2 || threshold < 0.0) {
+        printf("Error: compare expects BASE CURRENT [--threshold PCT] [--across-configs]\n");
+        return -1;
+    }
+
+    std::vector<result_record_t> base_records, cur_records;
+    if (results_load(paths[0], &base_records) < 0 || results_load(paths[1], &cur_records) < 0)
+        return -1;
+    if (base_records.empty() || cur_records.empty()) {
+        printf("Error: a results file has no records\n");
+        return -1;
+    }
+
+    for (size_t i = 0; i < sizeof(result_env_fields) / sizeof(result_env_fields[0]); ++i) {
+        std::string before = result_field(base_records[0], result_env_fields[i]);
+        std::string after = result_field(cur_records[0], result_env_fields[i]);
+        if (before != after)
+            printf("Info: %s changed: '%s' -> '%s'\n", result_env_fields[i], before.c_str(), after.c_str());
+    }
+
+    std::vector<std::string> base_order, cur_order;
+    std::map<std::string, result_pool_t> base, cur;
+    pool_records(base_records, with_config, &base_order, &base);
+    pool_records(cur_records, with_config, &cur_order, &cur);
+
+    int compared = 0, regressions = 0, improvements = 0, missing = 0;
+    for (size_t k = 0; k < base_order.size(); ++k) {
+        const std::string& key = base_order[k];
+        std::map<std::string, result_pool_t>::iterator it = cur.find(key);
+        if (it == cur.end()) {
+            printf("%-70s only in %s\n", key.c_str(), paths[0]);
+            missing++;
+            continue;
+        }
+        const result_pool_t& b = base[key];
+        const result_pool_t& c = it->second;
+        std::string unit = result_field(b.first, "unit");
+        int higher_is_better = unit.size() >= 2 && unit.compare(unit.size() - 2, 2, "/s") == 0;
+        double change = b.mean != 0.0 ? (c.mean - b.mean) / fabs(b.mean) : 0.0;
+
+        /* Welch's t-test, single values only have the threshold */
+        double vb = pool_var_of_mean(b), vc = pool_var_of_mean(c);
+        int significant = 1;
+        if (vb + vc > 0.0) {
+            double denom = (b.n > 1 ? vb * vb / (b.n - 1) : 0.0) + (c.n > 1 ? vc * vc / (c.n - 1) : 0.0);
+            double df = denom > 0.0 ? (vb + vc) * (vb + vc) / denom : 1e9;
+            significant = fabs(c.mean - b.mean) / sqrt(vb + vc) > stats_t95(df > 1e6 ? 1000000 : (int)df);
+        }
+
+        const char* verdict = "";
+        if (significant && fabs(change) > threshold) {
+            int worse = higher_is_better ? change < 0.0 : change > 0.0;
+            verdict = worse ? "  REGRESSION" : "  improvement";
+            if (worse)
+                regressions++;
+            else
+                improvements++;
+        }
+        std::string config_note;
+        if (result_field(b.first, "config_hash") != result_field(c.first, "config_hash"))
+            config_note = " (config " + result_field(b.first, "config") + " -> " + result_field(c.first, "config") + ")";
+        printf("%-70s %.6g -> %.6g %s, %+.1f%%%s%s\n", key.c_str(), b.mean, c.mean, unit.c_str(),
+                100.0 * change, verdict, config_note.c_str());
+        compared++;
+    }
+    for (size_t k = 0; k < cur_order.size(); ++k) {
+        if (base.find(cur_order[k]) == base.end()) {
+            printf("%-70s only in %s\n", cur_order[k].c_str(), paths[1]);
+            missing++;
+        }
+    }
+
+    printf("Info: compared %d cases, %d regressions, %d improvements, %d unmatched (threshold %.1f%%)\n",
+            compared, regressions, improvements, missing, 100.0 * threshold);
+    return regressions ? 1 : 0;
+}
@@ -0,0 +1,280 @@
+/* Rpc.cpp - host side of the exitless RPC engine and its benchmark.
+ *
+ * Host worker threads poll the request ring, execute what the enclave
+ * posted and push completions to the completion ring. Idle workers spin,
+ * PAUSE, or (futex policy) go to sleep until the enclave wakes them with
+ * ocall_rpc_wake.
+ */
+
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#include "../App.h"
+#include "Enclave_u.h"
+#include "histogram.h"
+#include "rpc_ring.h"
+
+struct rpc_engine_t {
+    rpc_ring_ref_t req;
+    rpc_ring_ref_t cpl;
+    int policy;
+    std::atomic<bool> stop;
+    std::vector<std::thread> workers;
+};
+
+static const char* rpc_policy_names[] = { "spin", "pause", "futex" };
+
+static long futex(uint32_t* uaddr, int op, uint32_t val, const struct timespec* timeout)
+{
+    return syscall(SYS_futex, uaddr, op, val, timeout, NULL, 0);
+}
+
+void ocall_rpc_wake(void* ring)
+{
+    futex(&((rpc_ring_t*)ring)->futex_word, FUTEX_WAKE_PRIVATE, 1, NULL);
+}
+
+/* Sleep until the enclave posts a request (or 10 ms passed) */
+static void rpc_worker_sleep(rpc_engine_t* e)
+{
+    rpc_ring_t* ring = e->req.ring;
+    struct timespec timeout = { 0, 10 * 1000 * 1000 };
+    uint32_t word = __atomic_load_n(&ring->futex_word, __ATOMIC_ACQUIRE);
+
+    __atomic_fetch_add(&ring->sleepers, 1, __ATOMIC_SEQ_CST);
+    if (!rpc_ring_pending(&e->req) && !e->stop.load())
+        futex(&ring->futex_word, FUTEX_WAIT_PRIVATE, word, &timeout);
+    __atomic_fetch_sub(&ring->sleepers, 1, __ATOMIC_SEQ_CST);
+}
+
+static void rpc_worker(rpc_engine_t* e)
+{
+    uint8_t* payload = (uint8_t*)malloc(e->req.payload_size ? e->req.payload_size : 1);
+    unsigned long idle = 0;
+    rpc_msg_t msg;
+
+    while (!e->stop.load(std::memory_order_relaxed)) {
+        if (!rpc_try_dequeue(&e->req, &msg, payload, (uint32_t)e->req.payload_size)) {
+            if (e->policy == RPC_POLL_FUTEX && ++idle > RPC_FUTEX_SPIN_LIMIT) {
+                rpc_worker_sleep(e);
+                idle = 0;
+            } else {
+                rpc_poll_backoff(e->policy);
+            }
+            continue;
+        }
+        idle = 0;
+
+        /* same work as the ocall_void / ocall_in / ocall_out bodies: none,
+         * RPC_OP_WAIT emulates a syscall that takes msg.arg cycles */
+        uint32_t out_len = 0;
+        switch (msg.opcode) {
+        case RPC_OP_VOID:
+        case RPC_OP_IN:
+            msg.result = 0;
+            break;
+        case RPC_OP_OUT:
+            out_len = msg.out_len <= e->cpl.payload_size ? msg.out_len : 0;
+            msg.result = out_len == msg.out_len ? 0 : -1;
+            break;
+        case RPC_OP_WAIT: {
+            uint64_t start_tsc = rdtsc();
+            while (rdtsc() - start_tsc < msg.arg)
+                __builtin_ia32_pause();
+            msg.result = 0;
+            break;
+        }
+        default:
+            msg.result = -1;
+            break;
+        }
+
+        while (!rpc_try_enqueue(&e->cpl, &msg, payload, out_len))
+            rpc_poll_backoff(e->policy);
+    }
+
+    free(payload);
+}
+
+static void* rpc_ring_alloc(rpc_ring_ref_t* ref, uint64_t capacity, uint64_t payload_size)
+{
+    void* mem = NULL;
+    if (posix_memalign(&mem, RPC_CACHELINE, rpc_ring_bytes(capacity, payload_size)) != 0)
+        return NULL;
+    rpc_ring_ref_init(ref, mem, capacity, payload_size);
+    rpc_ring_init(ref);
+    return mem;
+}
+
+/* rpc_engine_start:
+ *   Allocate the rings, start the workers and attach the enclave.
+ */
+rpc_engine_t* rpc_engine_start(int nworkers, int policy, uint64_t capacity, uint64_t payload_size)
+{
+    rpc_engine_t* e = new rpc_engine_t;
+    memset(&e->req, 0, sizeof(e->req));
+    memset(&e->cpl, 0, sizeof(e->cpl));
+    e->policy = policy;
+    e->stop = false;
+    if (!rpc_ring_alloc(&e->req, capacity, payload_size) || !rpc_ring_alloc(&e->cpl, capacity, payload_size)) {
+        printf("Error: rpc ring allocation failed\n");
+        free(e->req.ring);
+        free(e->cpl.ring);
+        delete e;
+        return NULL;
+    }
+
+    int ret = -1;
+    if (ecall_rpc_setup(global_eid, &ret, e->req.ring, e->cpl.ring, capacity, payload_size, policy) != SGX_SUCCESS || ret != 0) {
+        printf("Error: ecall_rpc_setup failed\n");
+        free(e->req.ring);
+        free(e->cpl.ring);
+        delete e;
+        return NULL;
+    }
+
+    for (int w = 0; w < nworkers; ++w)
+        e->workers.push_back(std::thread(rpc_worker, e));
+    return e;
+}
+
+void rpc_engine_stop(rpc_engine_t* e)
+{
+    e->stop = true;
+    __atomic_fetch_add(&e->req.ring->futex_word, 1, __ATOMIC_SEQ_CST);
+    futex(&e->req.ring->futex_word, FUTEX_WAKE_PRIVATE, (uint32_t)e->workers.size(), NULL);
+    for (size_t w = 0; w < e->workers.size(); ++w)
+        e->workers[w].join();
+    /* the enclave must not touch the rings once they are freed */
+    ecall_rpc_detach(global_eid);
+    free(e->req.ring);
+    free(e->cpl.ring);
+    delete e;
+}
+
+int rpc_policy_from_name(const char* name)
+{
+    for (int p = 0; p < (int)(sizeof(rpc_policy_names) / sizeof(rpc_policy_names[0])); ++p) {
+        if (strcmp(name, rpc_policy_names[p]) == 0)
+            return p;
+    }
+    return -1;
+}
+
+typedef struct _rpc_arg_t {
+    int op;
+    int len;
+    unsigned long loops;
+    histogram_t* hists;    /* one per caller of the throughput run */
+} rpc_arg_t;
+
+static void run_ocall(void* arg, histogram_t* hist)
+{
+    rpc_arg_t* a = (rpc_arg_t*)arg;
+    if (a->op == RPC_OP_VOID)
+        ecall_ocall_void(global_eid, (int)a->loops);
+    else if (a->op == RPC_OP_IN)
+        ecall_ocall_in(global_eid, (int)a->loops, a->len);
+    else
+        ecall_ocall_out(global_eid, (int)a->loops, a->len);
+    ecall_get_ocall_histogram(global_eid, hist);
+}
+
+static void run_rpc(void* arg, histogram_t* hist)
+{
+    rpc_arg_t* a = (rpc_arg_t*)arg;
+    if (a->op == RPC_OP_VOID)
+        ecall_rpc_void(global_eid, (int)a->loops, hist);
+    else if (a->op == RPC_OP_IN)
+        ecall_rpc_in(global_eid, (int)a->loops, a->len, hist);
+    else
+        ecall_rpc_out(global_eid, (int)a->loops, a->len, hist);
+}
+
+/* The throughput callers, each in its own ECALL. The ocall ECALLs share one
+ * histogram in the enclave, only the single-caller latency run reads it.
+ */
+static void ocall_caller(void* arg, int caller, unsigned long loops)
+{
+    rpc_arg_t* a = (rpc_arg_t*)arg;
+    if (a->op == RPC_OP_VOID)
+        ecall_ocall_void(global_eid, (int)loops);
+    else if (a->op == RPC_OP_IN)
+        ecall_ocall_in(global_eid, (int)loops, a->len);
+    else
+        ecall_ocall_out(global_eid, (int)loops, a->len);
+}
+
+static void rpc_caller(void* arg, int caller, unsigned long loops)
+{
+    rpc_arg_t* a = (rpc_arg_t*)arg;
+    histogram_t* hist = &a->hists[caller];
+    if (a->op == RPC_OP_VOID)
+        ecall_rpc_void(global_eid, (int)loops, hist);
+    else if (a->op == RPC_OP_IN)
+        ecall_rpc_in(global_eid, (int)loops, a->len, hist);
+    else
+        ecall_rpc_out(global_eid, (int)loops, a->len, hist);
+}
+
+/* Latency of one enclave thread, then the throughput of `callers` enclave
+ * threads calling at once, `loops` calls in total per trial.
+ */
+static void measure_rpc_case(const char* kind, void (*run)(void* arg, histogram_t* hist),
+                             void (*caller)(void* arg, int caller, unsigned long loops), rpc_arg_t* arg, int callers)
+{
+    static histogram_t hist;
+    const char* op_name = arg->op == RPC_OP_VOID ? "void" : arg->op == RPC_OP_IN ? "in" : "out";
+    char name[64], label[80], mean[160], percentiles[256];
+    stats_result_t stats, throughput;
+
+    hist_trial_t trial = { run, arg, &hist };
+    hist_reset(&hist);
+    stats_measure(hist_trial, &trial, &stats);
+
+    callers_trial_t concurrent = { caller, arg, callers, arg->loops / callers ? arg->loops / callers : 1 };
+    stats_measure(callers_trial, &concurrent, &throughput);
+
+    if (arg->op == RPC_OP_VOID)
+        snprintf(name, sizeof(name), "[%s %s]", kind, op_name);
+    else
+        snprintf(name, sizeof(name), "[%s %s (long[%d])]", kind, op_name, arg->len);
+    stats_format_cycles(&stats, mean, sizeof(mean));
+    hist_format(&hist, percentiles, sizeof(percentiles));
+    printf("%-30s switching time is %s, %s, throughput is %.0f ± %.0f calls/s (%d callers)\n",
+            name, mean, percentiles, throughput.mean, throughput.ci, callers);
+    results_add(name, "cycles", &stats);
+    snprintf(label, sizeof(label), "%.*s %d callers", (int)strlen(name) - 2, name + 1, callers);
+    results_add(label, "calls/s", &throughput);
+}
+
+/* rpc_benchmark:
+ *   Exitless RPC void / in / out next to the real ocall void / in / out,
+ *   trials of `loops` calls.
+ */
+void rpc_benchmark(unsigned long loops, int nworkers, int policy, int len, int callers)
+{
+    uint64_t payload_size = (uint64_t)len * sizeof(long);
+
+    rpc_engine_t* e = rpc_engine_start(nworkers, policy, 64, payload_size);
+    if (e == NULL)
+        return;
+    printf("Info: rpc workers: %d, policy: %s, callers: %d\n", nworkers, rpc_policy_names[policy], callers);
+
+    histogram_t* hists = (histogram_t*)malloc(callers * sizeof(histogram_t));
+    for (int op = RPC_OP_VOID; op <= RPC_OP_OUT; ++op) {
+        rpc_arg_t arg = { op, len, loops, hists };
+        measure_rpc_case("ocall", run_ocall, ocall_caller, &arg, callers);
+        measure_rpc_case("rpc", run_rpc, rpc_caller, &arg, callers);
+    }
+    free(hists);
+
+    rpc_engine_stop(e);
+}
@@ -0,0 +1,188 @@
+/* Scaling.cpp - multi-threaded ECALL scalability benchmark.
+ *
+ * N host threads, each pinned to one CPU of a configurable list, hammer the
+ * same enclave with ECALLs. N is swept 1, 2, 4, ... up to max_threads, which
+ * should not exceed the TCSNum of the loaded enclave.
+ */
+
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../App.h"
+#include "Enclave_u.h"
+#include "histogram.h"
+
+struct scaling_thread_ctx_t {
+    int cpu;               /* -1 means no affinity */
+    int ecall;             /* index into scaling_ecalls */
+    int len;
+    unsigned long loops;
+    long* ptr;
+    int warm;              /* do not record this trial */
+    unsigned long errors;
+    histogram_t hist;      /* every call of the measured trials */
+};
+
+static const char* scaling_ecalls[] = { "ecall void", "ecall in", "ecall out", "ecall inout" };
+
+static std::atomic<int> scaling_ready(0);
+static std::atomic<bool> scaling_go(false);
+
+/* Parse a cpu list like "0,2,4-7" */
+std::vector<int> parse_cpu_list(const char* list)
+{
+    std::vector<int> cpus;
+    const char* p = list;
+    while (p && *p) {
+        char* end = NULL;
+        long first = strtol(p, &end, 10);
+        long last = first;
+        if (end == p)
+            break;
+        if (*end == '-') {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+        }
+        for (long cpu = first; cpu <= last; ++cpu)
+            cpus.push_back((int)cpu);
+        p = (*end == ',') ? end + 1 : NULL;
+    }
+    return cpus;
+}
+
+static sgx_status_t scaling_call(int ecall, long* ptr, int len)
+{
+    switch (ecall) {
+    case 0: return ecall_void(global_eid);
+    case 1: return ecall_in(global_eid, ptr, len);
+    case 2: return ecall_out(global_eid, ptr, len);
+    default: return ecall_inout(global_eid, ptr, len);
+    }
+}
+
+static void scaling_thread(scaling_thread_ctx_t* ctx)
+{
+    if (ctx->cpu >= 0) {
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        CPU_SET(ctx->cpu, &mask);
+        sched_setaffinity(0, sizeof(mask), &mask);
+    }
+
+    /* warm up and take a TCS before the clock starts */
+    for (unsigned long loop = 0; loop < ctx->loops / 10; loop++)
+        scaling_call(ctx->ecall, ctx->ptr, ctx->len);
+
+    scaling_ready++;
+    while (!scaling_go.load())
+        __builtin_ia32_pause();
+
+    for (unsigned long loop = 0; loop < ctx->loops; loop++) {
+        uint64_t start_tsc = rdtsc();
+        sgx_status_t ret = scaling_call(ctx->ecall, ctx->ptr, ctx->len);
+        uint64_t cycles = timing_since(start_tsc);
+        if (!ctx->warm)
+            hist_record(&ctx->hist, cycles);
+        if (ret != SGX_SUCCESS)
+            ctx->errors++;
+    }
+}
+
+struct scaling_step_t {
+    std::vector<scaling_thread_ctx_t*> ctxs;
+    unsigned long loops;
+};
+
+/* One trial: all threads run `loops` ECALLs, returns the total calls/s */
+static double scaling_trial(void* arg, int warm)
+{
+    scaling_step_t* step = (scaling_step_t*)arg;
+    int nthreads = (int)step->ctxs.size();
+    std::vector<std::thread> threads;
+
+    scaling_ready = 0;
+    scaling_go = false;
+    for (int t = 0; t < nthreads; ++t) {
+        step->ctxs[t]->warm = warm;
+        threads.push_back(std::thread(scaling_thread, step->ctxs[t]));
+    }
+
+    while (scaling_ready.load() < nthreads)
+        __builtin_ia32_pause();
+    double start_sec = wall_time_sec();
+    scaling_go = true;
+    for (int t = 0; t < nthreads; ++t)
+        threads[t].join();
+    double stop_sec = wall_time_sec();
+
+    return (double)nthreads * (double)step->loops / (stop_sec - start_sec);
+}
+
+static void run_scaling_step(int ecall, int nthreads, const std::vector<int>& cpus,
+                             unsigned long loops, int len)
+{
+    scaling_step_t step;
+    step.loops = loops;
+    for (int t = 0; t < nthreads; ++t) {
+        scaling_thread_ctx_t* ctx = (scaling_thread_ctx_t*)malloc(sizeof(scaling_thread_ctx_t));
+        ctx->cpu = cpus.empty() ? -1 : cpus[t % cpus.size()];
+        ctx->ecall = ecall;
+        ctx->len = len;
+        ctx->loops = loops;
+        ctx->ptr = (long*)malloc(len * sizeof(long));
+        ctx->errors = 0;
+        hist_reset(&ctx->hist);
+        step.ctxs.push_back(ctx);
+    }
+
+    stats_result_t stats;
+    stats_measure(scaling_trial, &step, &stats);
+
+    unsigned long errors = 0;
+    for (int t = 0; t < nthreads; ++t)
+        errors += step.ctxs[t]->errors;
+
+    char name[64];
+    if (ecall == 0)
+        snprintf(name, sizeof(name), "[%s]", scaling_ecalls[ecall]);
+    else
+        snprintf(name, sizeof(name), "[%s (long[%d])]", scaling_ecalls[ecall], len);
+    printf("%-30s [ threads: %d]    throughput is %.0f ± %.0f calls/s, n=%d%s, errors: %lu\n",
+            name, nthreads, stats.mean, stats.ci, stats.trials, stats.converged ? "" : ", ci target missed", errors);
+    char label[80];
+    snprintf(label, sizeof(label), "%s %d threads", scaling_ecalls[ecall], nthreads);
+    results_add(label, "calls/s", &stats);
+
+    char percentiles[256];
+    for (int t = 0; t < nthreads; ++t) {
+        scaling_thread_ctx_t* ctx = step.ctxs[t];
+        hist_format(&ctx->hist, percentiles, sizeof(percentiles));
+        printf("    thread %d (cpu %d): switching time is %lu ± %.0f cycles (%.1f ns), %s\n",
+                t, ctx->cpu, (unsigned long)hist_mean(&ctx->hist), hist_ci95(&ctx->hist),
+                timing_ns(hist_mean(&ctx->hist)), percentiles);
+        free(ctx->ptr);
+        free(ctx);
+    }
+}
+
+/* ecall_scaling_benchmark:
+ *   Sweep the number of ECALL threads for ecall void / in / out / inout.
+ */
+void ecall_scaling_benchmark(int max_threads, const char* cpu_list, unsigned long loops, int len)
+{
+    std::vector<int> cpus = parse_cpu_list(cpu_list);
+    int ncases = (int)(sizeof(scaling_ecalls) / sizeof(scaling_ecalls[0]));
+
+    for (int ecall = 0; ecall < ncases; ++ecall) {
+        for (int nthreads = 1; nthreads <= max_threads; nthreads *= 2) {
+            run_scaling_step(ecall, nthreads, cpus, loops, len);
+            if (nthreads < max_threads && nthreads * 2 > max_threads)
+                run_scaling_step(ecall, max_threads, cpus, loops, len);
+        }
+    }
+}
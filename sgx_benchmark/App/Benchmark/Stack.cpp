@@ -0,0 +1,120 @@
+/* Stack.cpp - cost of growing the stack of a dynamically added thread.
+ *
+ * For every depth a freshly loaded enclave gets `pool` threads parked inside
+ * (ecall_edmm_busy), which takes the TCSMinPool static TCS, then a new thread
+ * enters and lands on a TCS added at run time. Its stack starts at
+ * StackMinSize; it grows it one page at a time down to the depth and again
+ * over the committed pages. The difference is what a page of stack growth
+ * costs, only the pages more than min_kb (StackMinSize) below the stack
+ * pointer at the ecall count. config.04 grows from 8 KB, config.03 commits
+ * the whole stack of a new thread up front: `--config config.04,config.03`.
+ */
+
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "sgx_urts.h"
+#include "../App.h"
+#include "Enclave_u.h"
+#include "histogram.h"
+
+#define STACK_PAGE 4096
+
+static int stack_release = 0;
+static int stack_parked = 0;  /* pool threads inside, or that failed to enter */
+
+static void stack_pool_thread(void)
+{
+    long loops = 0;
+    if (ecall_edmm_busy(global_eid, &loops, &stack_release, &stack_parked) != SGX_SUCCESS || loops < 0)
+        __atomic_add_fetch(&stack_parked, 1, __ATOMIC_SEQ_CST);
+}
+
+static void stack_growth_thread(size_t pages, size_t committed, histogram_t* first, histogram_t* again, int* ret)
+{
+    if (ecall_stack_growth(global_eid, ret, pages, committed, first, again) != SGX_SUCCESS)
+        *ret = -1;
+}
+
+static void print_stack_hist(const char* name, long depth_kb, const histogram_t* hist)
+{
+    char percentiles[256], label[96];
+    hist_format(hist, percentiles, sizeof(percentiles));
+    printf("%-30s [ %4ld KB]    per page %lu ± %.0f cycles (%.1f ns), n=%lu, %s\n", name, depth_kb,
+            (unsigned long)hist_mean(hist), hist_ci95(hist), timing_ns((double)hist_mean(hist)),
+            (unsigned long)hist->count, percentiles);
+    snprintf(label, sizeof(label), "%s %ldKB", name, depth_kb);
+    results_add_hist(label, "cycles/page", hist, 1.0);
+}
+
+/* stack_growth_benchmark:
+ *   depths is a comma separated list of stack depths in KB, pool the number
+ *   of static TCS (TCSMinPool) to occupy first, min_kb the stack a new
+ *   thread starts with (StackMinSize).
+ */
+int stack_growth_benchmark(const char* config, const char* depths, int pool, long min_kb)
+{
+    std::vector<long> depth_kbs;
+    for (const char* p = depths; p && *p; ) {
+        char* end = NULL;
+        long kb = strtol(p, &end, 0);
+        if (end == p || kb < 4) {
+            printf("Error: stack depths should be a list of sizes >= 4 KB, got '%s'\n", depths);
+            return -1;
+        }
+        depth_kbs.push_back(kb);
+        p = *end == ',' ? end + 1 : NULL;
+    }
+    if (pool < 0 || min_kb < 0) {
+        printf("Error: pool and min_kb should be >= 0\n");
+        return -1;
+    }
+
+    histogram_t* first = (histogram_t*)malloc(sizeof(histogram_t));
+    histogram_t* again = (histogram_t*)malloc(sizeof(histogram_t));
+    int failures = 0;
+    for (size_t i = 0; i < depth_kbs.size(); ++i) {
+        if (initialize_enclave(config) < 0) {
+            failures++;
+            break;
+        }
+
+        std::vector<std::thread> parked;
+        __atomic_store_n(&stack_parked, 0, __ATOMIC_SEQ_CST);
+        __atomic_store_n(&stack_release, 0, __ATOMIC_SEQ_CST);
+        for (int t = 0; t < pool; ++t)
+            parked.push_back(std::thread(stack_pool_thread));
+        while (__atomic_load_n(&stack_parked, __ATOMIC_SEQ_CST) < pool)
+            usleep(10);
+
+        int ret = -1;
+        size_t pages = (size_t)depth_kbs[i] * 1024 / STACK_PAGE;
+        std::thread grower(stack_growth_thread, pages, (size_t)min_kb * 1024, first, again, &ret);
+        grower.join();
+
+        __atomic_store_n(&stack_release, 1, __ATOMIC_SEQ_CST);
+        for (size_t t = 0; t < parked.size(); ++t)
+            parked[t].join();
+        sgx_destroy_enclave(global_eid);
+
+        if (ret != 0) {
+            printf("Error: [stack growth] %ld KB failed (no page past min_kb?)\n", depth_kbs[i]);
+            failures++;
+            continue;
+        }
+        print_stack_hist("[stack first touch]", depth_kbs[i], first);
+        print_stack_hist("[stack re-touch]", depth_kbs[i], again);
+        double growth = (double)hist_mean(first) - (double)hist_mean(again);
+        printf("%-30s [ %4ld KB]    per page %.0f cycles (%.1f ns), %.0f cycles for the whole depth\n",
+                "[stack growth]", depth_kbs[i], growth, timing_ns(growth), growth * first->count);
+        char label[96];
+        snprintf(label, sizeof(label), "stack growth %ldKB", depth_kbs[i]);
+        results_add_value(label, "cycles/page", growth);
+    }
+    free(first);
+    free(again);
+    return failures ? -1 : 0;
+}
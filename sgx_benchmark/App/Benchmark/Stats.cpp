@@ -0,0 +1,237 @@
+/* Stats.cpp - statistical run engine.
+ *
+ * A measurement is a series of trials of the same work. Warm-up trials run
+ * until two consecutive windows agree within warmup_tolerance. Measured
+ * trials then run until the 95% confidence interval of their mean is within
+ * ci_target of the mean, or until max_trials or the time budget is reached
+ * (min_trials always run). Trials further than 3.5 scaled MADs from the
+ * median are rejected as outliers before the mean is taken.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include "../App.h"
+
+#define STATS_WARMUP_WINDOW 2
+#define STATS_OUTLIER_MADS  3.5
+
+stats_config_t stats_config = {
+    5,     /* min_trials */
+    100,   /* max_trials */
+    0.01,  /* ci_target */
+    5.0,   /* budget_sec */
+    20,    /* max_warmup */
+    0.02,  /* warmup_tolerance */
+};
+
+/* Two-sided 95% Student t quantile for df degrees of freedom */
+double stats_t95(int df)
+{
+    static const double table[] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+    };
+    if (df < 1)
+        return 0.0;
+    if (df <= 30)
+        return table[df - 1];
+    if (df <= 40)
+        return 2.021;
+    if (df <= 60)
+        return 2.000;
+    if (df <= 120)
+        return 1.980;
+    return 1.960;
+}
+
+static double median_of(std::vector<double> v)
+{
+    std::sort(v.begin(), v.end());
+    size_t n = v.size();
+    return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2.0;
+}
+
+static void stats_summarize(const std::vector<double>& samples, stats_result_t* r)
+{
+    double median = median_of(samples);
+    std::vector<double> deviations;
+    for (size_t i = 0; i < samples.size(); ++i)
+        deviations.push_back(fabs(samples[i] - median));
+    /* 1.4826 * MAD estimates the standard deviation of normal data */
+    double limit = STATS_OUTLIER_MADS * 1.4826 * median_of(deviations);
+
+    double sum = 0.0, sumsq = 0.0;
+    int kept = 0;
+    for (size_t i = 0; i < samples.size(); ++i) {
+        if (limit > 0.0 && fabs(samples[i] - median) > limit)
+            continue;
+        sum += samples[i];
+        sumsq += samples[i] * samples[i];
+        kept++;
+    }
+
+    r->trials = kept;
+    r->outliers = (int)samples.size() - kept;
+    r->mean = sum / kept;
+    double var = kept > 1 ? (sumsq - r->mean * sum) / (kept - 1) : 0.0;
+    r->stddev = var > 0.0 ? sqrt(var) : 0.0;
+    r->ci = kept > 1 ? stats_t95(kept - 1) * r->stddev / sqrt((double)kept) : 0.0;
+}
+
+static bool stats_steady(const std::vector<double>& warm)
+{
+    size_t n = warm.size();
+    if (n < 2 * STATS_WARMUP_WINDOW)
+        return false;
+    double last = 0.0, prev = 0.0;
+    for (size_t i = 0; i < STATS_WARMUP_WINDOW; ++i) {
+        last += warm[n - 1 - i];
+        prev += warm[n - 1 - STATS_WARMUP_WINDOW - i];
+    }
+    return fabs(last - prev) <= stats_config.warmup_tolerance * fabs(last);
+}
+
+/* stats_measure:
+ *   Run trial(ctx, warm) as described above, warm is 1 for warm-up trials.
+ */
+void stats_measure(stats_trial_t trial, void* ctx, stats_result_t* r)
+{
+    std::vector<double> warm;
+    std::vector<double> samples;
+    double start_sec = wall_time_sec();
+
+    memset(r, 0, sizeof(*r));
+    while (r->warmup < stats_config.max_warmup) {
+        warm.push_back(trial(ctx, 1));
+        r->warmup++;
+        if (stats_steady(warm) || wall_time_sec() - start_sec > stats_config.budget_sec / 4)
+            break;
+    }
+
+    for (;;) {
+        samples.push_back(trial(ctx, 0));
+        stats_summarize(samples, r);
+
+        int n = (int)samples.size();
+        if (n < stats_config.min_trials)
+            continue;
+        if (r->ci <= stats_config.ci_target * fabs(r->mean)) {
+            r->converged = 1;
+            break;
+        }
+        if (n >= stats_config.max_trials || wall_time_sec() - start_sec > stats_config.budget_sec)
+            break;
+    }
+}
+
+/* "mean ± ci cycles (ns), n=trials[, k outliers][, ci target missed]" */
+int stats_format_cycles(const stats_result_t* r, char* buf, size_t len)
+{
+    int n = snprintf(buf, len, "%.0f ± %.0f cycles (%.1f ± %.1f ns), n=%d",
+            r->mean, r->ci, timing_ns(r->mean), timing_ns(r->ci), r->trials);
+    if (r->outliers && n >= 0 && (size_t)n < len)
+        n += snprintf(buf + n, len - n, ", %d outlier%s", r->outliers, r->outliers > 1 ? "s" : "");
+    if (!r->converged && n >= 0 && (size_t)n < len)
+        n += snprintf(buf + n, len - n, ", ci target missed");
+    return n;
+}
+
+/* stats_ratio:
+ *   num / den of two independent measurements. The relative CIs add in
+ *   quadrature; trials is the smaller count and stddev is what gives the
+ *   same CI over it, so compare can pool ratios like any other record.
+ */
+void stats_ratio(const stats_result_t* num, const stats_result_t* den, stats_result_t* r)
+{
+    memset(r, 0, sizeof(*r));
+    if (den->mean == 0.0)
+        return;
+    r->mean = num->mean / den->mean;
+    double rel_num = num->mean != 0.0 ? num->ci / num->mean : 0.0;
+    double rel_den = den->ci / den->mean;
+    r->ci = fabs(r->mean) * sqrt(rel_num * rel_num + rel_den * rel_den);
+    r->trials = num->trials < den->trials ? num->trials : den->trials;
+    double t = stats_t95(r->trials - 1);
+    r->stddev = t > 0.0 ? r->ci * sqrt((double)r->trials) / t : 0.0;
+    r->outliers = num->outliers + den->outliers;
+    r->warmup = num->warmup + den->warmup;
+    r->converged = num->converged && den->converged;
+}
+
+/* call_trial:
+ *   ctx is a call_trial_t, 'loops' calls each timed from the App. Calls of
+ *   measured trials go to hist, the figure is the mean cycles per call.
+ */
+double call_trial(void* ctx, int warm)
+{
+    call_trial_t* t = (call_trial_t*)ctx;
+    uint64_t total = 0;
+    for (unsigned long loop = 0; loop < t->loops; loop++) {
+        uint64_t start_tsc = rdtsc();
+        t->call(t->arg);
+        uint64_t cycles = timing_since(start_tsc);
+        total += cycles;
+        if (!warm)
+            hist_record(t->hist, cycles);
+    }
+    return (double)total / (double)t->loops;
+}
+
+static std::atomic<int> callers_ready(0);
+static std::atomic<bool> callers_go(false);
+
+static void callers_thread(callers_trial_t* t, int caller)
+{
+    callers_ready++;
+    while (!callers_go.load())
+        __builtin_ia32_pause();
+    t->run(t->arg, caller, t->loops);
+}
+
+/* callers_trial:
+ *   ctx is a callers_trial_t, `callers` threads make their `loops` calls
+ *   through run() at the same time. The figure is the calls all of them
+ *   completed per wall-clock second, so it shows what concurrent callers
+ *   and the workers serving them get through, not an inverted latency.
+ */
+double callers_trial(void* ctx, int warm)
+{
+    callers_trial_t* t = (callers_trial_t*)ctx;
+    std::vector<std::thread> threads;
+
+    callers_ready = 0;
+    callers_go = false;
+    for (int c = 0; c < t->callers; ++c)
+        threads.push_back(std::thread(callers_thread, t, c));
+    while (callers_ready.load() < t->callers)
+        __builtin_ia32_pause();
+    double start_sec = wall_time_sec();
+    callers_go = true;
+    for (int c = 0; c < t->callers; ++c)
+        threads[c].join();
+    double stop_sec = wall_time_sec();
+    return (double)t->callers * (double)t->loops / (stop_sec - start_sec);
+}
+
+/* hist_trial:
+ *   ctx is a hist_trial_t, whose run() times its calls itself (e.g. OCALLs
+ *   inside the enclave) and hands back their histogram. Measured trials are
+ *   merged into hist, the figure is the mean of the trial.
+ */
+double hist_trial(void* ctx, int warm)
+{
+    static histogram_t trial_hist;
+    hist_trial_t* t = (hist_trial_t*)ctx;
+    hist_reset(&trial_hist);
+    t->run(t->arg, &trial_hist);
+    if (!warm)
+        hist_merge(t->hist, &trial_hist);
+    return trial_hist.count ? (double)trial_hist.sum / (double)trial_hist.count : 0.0;
+}
@@ -0,0 +1,170 @@
+/* Stream.cpp - STREAM copy / scale / add / triad bandwidth.
+ *
+ * Every kernel of stream_kernels.h, for every instruction set the CPU has
+ * (CPUID, and XCR0 for the OS saving the vector state) and with regular and
+ * non-temporal stores, runs three ways over three arrays of the same size:
+ *   sgx            in the enclave, arrays in the EPC
+ *   sgx untrusted  in the enclave, arrays in untrusted memory
+ *   linux          in the App, on the same untrusted arrays
+ * The untrusted arrays use 4 KB pages like the EPC. Bandwidth is STREAM's:
+ * bytes the kernel reads and writes over the best pass, the first pass is a
+ * warm-up. Only the sgx arrays go through the memory encryption engine.
+ */
+
+#include <cpuid.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <vector>
+
+#include "../App.h"
+#include "Enclave_u.h"
+#include "stream_kernels.h"
+
+#define STREAM_WAYS 3
+
+static const char* stream_ways[STREAM_WAYS] = { "sgx", "sgx untrusted", "linux" };
+
+/* Widest instruction set the CPU runs and the OS saves the state of */
+static int stream_cpu_isa(void)
+{
+    unsigned int eax, ebx, ecx, edx, xcr0_lo, xcr0_hi;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_OSXSAVE) || !(ecx & bit_AVX))
+        return STREAM_ISA_SSE2;
+    __asm__ __volatile__ ("xgetbv" : "=a" (xcr0_lo), "=d" (xcr0_hi) : "c" (0));
+    if ((xcr0_lo & 0x6) != 0x6 || __get_cpuid_max(0, NULL) < 7)
+        return STREAM_ISA_SSE2;  /* no SSE + AVX state */
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    if ((ebx & bit_AVX512F) && (xcr0_lo & 0xe0) == 0xe0)
+        return STREAM_ISA_AVX512;  /* opmask and ZMM state too */
+    return (ebx & bit_AVX2) ? STREAM_ISA_AVX2 : STREAM_ISA_SSE2;
+}
+
+/* Best pass after the warm-up one */
+static uint64_t stream_best(const std::vector<uint64_t>& cycles)
+{
+    uint64_t best = cycles.back();
+    for (size_t p = cycles.size() > 1 ? 1 : 0; p < cycles.size(); ++p) {
+        if (cycles[p] < best)
+            best = cycles[p];
+    }
+    return best;
+}
+
+/* GB/s, bytes per ns */
+static double stream_gbps(double bytes, uint64_t cycles)
+{
+    double ns = timing_ns((double)cycles);
+    return ns > 0.0 ? bytes / ns : 0.0;
+}
+
+static int stream_run(int way, int isa, int nt, int op, double** u, size_t n, std::vector<uint64_t>* cycles)
+{
+    int ret = -1;
+    if (way != STREAM_WAYS - 1) {
+        if (ecall_stream_run(global_eid, &ret, way, isa, nt, op, (int)cycles->size(), cycles->data()) != SGX_SUCCESS)
+            return -1;
+        return ret;
+    }
+    for (size_t p = 0; p < cycles->size(); ++p) {
+        uint64_t start_tsc = rdtsc();
+        if (stream_kernel(isa, nt, op, u[0], u[1], u[2], n) != 0)
+            return -1;
+        (*cycles)[p] = timing_since(start_tsc);
+    }
+    return 0;
+}
+
+/* stream_benchmark:
+ *   array_mb per array, passes per kernel including the warm-up one, isa
+ *   "auto" for every instruction set the CPU has, or one of them.
+ */
+int stream_benchmark(long array_mb, int passes, const char* isa)
+{
+    int max_isa = stream_cpu_isa();
+    int first_isa = STREAM_ISA_SSE2, last_isa = max_isa;
+
+    if (array_mb < 1 || passes < 1) {
+        printf("Error: need array_mb >= 1 and passes >= 1\n");
+        return -1;
+    }
+    if (strcmp(isa, "auto") != 0) {
+        first_isa = 0;
+        while (first_isa < STREAM_ISA_COUNT && strcmp(stream_isa_names[first_isa], isa) != 0)
+            first_isa++;
+        if (first_isa == STREAM_ISA_COUNT) {
+            printf("Error: isa should be auto, sse2, avx2 or avx512\n");
+            return -1;
+        }
+        if (first_isa > max_isa) {
+            printf("Error: this CPU has no %s, it goes up to %s\n", isa, stream_isa_names[max_isa]);
+            return -1;
+        }
+        last_isa = first_isa;
+    }
+
+    size_t n = ((size_t)array_mb << 20) / sizeof(double) / STREAM_BLOCK * STREAM_BLOCK;
+    size_t bytes = n * sizeof(double);
+    double* u[3] = { NULL, NULL, NULL };
+    const double init[3] = { 1.0, 2.0, 0.0 };
+    int ret = -1;
+    for (int i = 0; i < 3; ++i) {
+        void* p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) {
+            printf("Error: cannot map %ld MB\n", array_mb);
+            goto out;
+        }
+        madvise(p, bytes, MADV_NOHUGEPAGE);
+        u[i] = (double*)p;
+        for (size_t j = 0; j < n; ++j)
+            u[i][j] = init[i];
+    }
+    if (ecall_stream_prepare(global_eid, &ret, n, u[0], u[1], u[2]) != SGX_SUCCESS || ret != 0) {
+        printf("Error: the enclave cannot hold 3 x %ld MB, see HeapMaxSize\n", array_mb);
+        ret = -1;
+        goto out;
+    }
+
+    {
+        std::vector<uint64_t> cycles(passes);
+        for (int s = first_isa; s <= last_isa && ret == 0; ++s) {
+            for (int nt = 0; nt < 2 && ret == 0; ++nt) {
+                for (int op = 0; op < STREAM_OP_COUNT && ret == 0; ++op) {
+                    double moved = (double)stream_op_arrays[op] * bytes;
+                    double gbps[STREAM_WAYS];
+                    char name[64], label[96];
+
+                    for (int way = 0; way < STREAM_WAYS && ret == 0; ++way) {
+                        ret = stream_run(way, s, nt, op, u, n, &cycles);
+                        gbps[way] = stream_gbps(moved, stream_best(cycles));
+                    }
+                    if (ret != 0) {
+                        printf("Error: [stream %s] failed\n", stream_isa_names[s]);
+                        break;
+                    }
+
+                    snprintf(name, sizeof(name), "[stream %s%s %s]", stream_isa_names[s], nt ? " nt" : "",
+                             stream_op_names[op]);
+                    printf("%-30s [ %ld MB]    sgx %.2f GB/s, sgx untrusted %.2f GB/s, linux %.2f GB/s, "
+                           "sgx / linux %.2f\n", name, array_mb, gbps[0], gbps[1], gbps[2],
+                           gbps[2] > 0.0 ? gbps[0] / gbps[2] : 0.0);
+                    for (int way = 0; way < STREAM_WAYS; ++way) {
+                        snprintf(label, sizeof(label), "stream %s%s %s %s", stream_isa_names[s], nt ? " nt" : "",
+                                 stream_op_names[op], stream_ways[way]);
+                        results_add_value(label, "GB/s", gbps[way]);
+                    }
+                }
+            }
+        }
+    }
+    ecall_stream_release(global_eid);
+
+out:
+    for (int i = 0; i < 3; ++i) {
+        if (u[i] != NULL)
+            munmap(u[i], bytes);
+    }
+    return ret;
+}
@@ -0,0 +1,255 @@
+/* Sweep.cpp - in-process sweeps over the memory benchmark matrices.
+ *
+ *   ./bench <affinity> sweep [plan...] [--cpus LIST] [--output FILE] [--resume]
+ *                            [--drift PCT] [--max-cooldown SEC]
+ *
+ * A plan is the list of points of one benchmark, see sweep_plans (no plan
+ * means all). Every point runs in this process and the enclave stays loaded:
+ * between points it gives back the memory the last point left behind
+ * (ecall_memory_state_reset) and is only reloaded if it cannot.
+ *
+ * Instead of a fixed sleep, the sweep times a fixed chain of dependent
+ * instructions before every point and waits until it runs within --drift
+ * (default 3%) of its speed at the start, at most --max-cooldown seconds
+ * (default 10).
+ *
+ * With --output, the records of a finished point go to FILE and the point to
+ * FILE.done. --resume appends to both and skips the points already done.
+ * --cpus runs every plan once per cpu of the list, pinned to it.
+ */
+
+#include <sched.h>
+#include <set>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "../App.h"
+
+#define SWEEP_PROBE_OPS    1000000
+#define SWEEP_PROBE_RUNS   5
+#define SWEEP_COOLDOWN_US  100000
+
+/* fewer blocks for the large ones, the scripts used the same matrix */
+static const char* memory_management_points[] = {
+    "page_num=1 num=100", "page_num=2 num=100", "page_num=4 num=100", "page_num=8 num=100",
+    "page_num=16 num=100", "page_num=32 num=100", "page_num=64 num=100", "page_num=128 num=100",
+    "page_num=256 num=100", "page_num=512 num=100", "page_num=1024 num=100", "page_num=2048 num=100",
+    "page_num=4096 num=100", "page_num=8192 num=50", "page_num=16384 num=10", "page_num=32768 num=10",
+    "page_num=65536 num=4", NULL,
+};
+
+static const char* memory_access_points[] = {
+    "block_size=64", "block_size=32", "block_size=16", "block_size=8", "block_size=4", "block_size=1", NULL,
+};
+
+struct sweep_plan_t {
+    const char* bench;
+    const char** points;
+};
+
+static const sweep_plan_t sweep_plans[] = {
+    { "memory_management", memory_management_points },
+    { "memory_access",     memory_access_points },
+};
+
+#define SWEEP_PLAN_COUNT ((int)(sizeof(sweep_plans) / sizeof(sweep_plans[0])))
+
+static double sweep_drift = 0.03;
+static double sweep_max_cooldown = 10.0;
+
+/* TSC ticks of a fixed dependent chain, the fastest of a few runs. It goes up
+ * when the core clocks down (thermal or power limits), the TSC does not.
+ */
+static double sweep_probe(void)
+{
+    double best = 0.0;
+    for (int run = 0; run < SWEEP_PROBE_RUNS; ++run) {
+        uint64_t x = run;
+        uint64_t start_tsc = rdtsc();
+        for (int i = 0; i < SWEEP_PROBE_OPS; ++i) {
+            x = x * 3 + 1;
+            __asm__ volatile("" : "+r"(x));
+        }
+        double ticks = (double)timing_since(start_tsc);
+        if (run == 0 || ticks < best)
+            best = ticks;
+    }
+    return best;
+}
+
+/* Wait until the probe is back within sweep_drift of reference */
+static void sweep_cooldown(double reference)
+{
+    double start_sec = wall_time_sec();
+    double probe = sweep_probe();
+    while (probe > reference * (1.0 + sweep_drift) && wall_time_sec() - start_sec < sweep_max_cooldown) {
+        usleep(SWEEP_COOLDOWN_US);
+        probe = sweep_probe();
+    }
+    double waited = wall_time_sec() - start_sec;
+    if (probe > reference * (1.0 + sweep_drift))
+        printf("Info: core still %.1f%% slower than at the start after %.1f s of cooldown\n",
+                100.0 * (probe / reference - 1.0), waited);
+    else if (waited * 1e6 >= SWEEP_COOLDOWN_US)
+        printf("Info: cooled down for %.1f s\n", waited);
+}
+
+static std::vector<std::string> split(const std::string& s, char sep)
+{
+    std::vector<std::string> parts;
+    size_t start = 0;
+    while (start <= s.size()) {
+        size_t end = s.find(sep, start);
+        if (end == std::string::npos)
+            end = s.size();
+        if (end > start)
+            parts.push_back(s.substr(start, end - start));
+        start = end + 1;
+    }
+    return parts;
+}
+
+static void sweep_load_done(const std::string& path, std::set<std::string>* done)
+{
+    FILE* f = fopen(path.c_str(), "r");
+    char line[256];
+    if (f == NULL)
+        return;
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\n")] = '\0';
+        if (line[0])
+            done->insert(line);
+    }
+    fclose(f);
+}
+
+static void sweep_set_cpu(int cpu)
+{
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    CPU_SET(cpu, &mask);
+    if (sched_setaffinity(0, sizeof(mask), &mask) != 0)
+        printf("Error: cannot run on cpu %d\n", cpu);
+    else
+        printf("Info: sweep on cpu %d\n", cpu);
+}
+
+/* sweep_main:
+ *   argv is [plan...] [options], see above.
+ */
+int sweep_main(int argc, char* argv[])
+{
+    std::vector<const sweep_plan_t*> plans;
+    std::vector<int> cpus;
+    const char* output = NULL;
+    int resume = 0;
+
+    for (int i = 0; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (strcmp(arg, "--cpus") == 0 && i + 1 < argc) {
+            std::vector<std::string> list = split(argv[++i], ',');
+            for (size_t c = 0; c < list.size(); ++c)
+                cpus.push_back(atoi(list[c].c_str()));
+        } else if (strcmp(arg, "--output") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (strcmp(arg, "--resume") == 0) {
+            resume = 1;
+        } else if (strcmp(arg, "--drift") == 0 && i + 1 < argc) {
+            sweep_drift = atof(argv[++i]) / 100.0;
+        } else if (strcmp(arg, "--max-cooldown") == 0 && i + 1 < argc) {
+            sweep_max_cooldown = atof(argv[++i]);
+        } else if (strncmp(arg, "--", 2) == 0) {
+            printf("Error: unknown option '%s'\n", arg);
+            return -1;
+        } else {
+            int p = 0;
+            while (p < SWEEP_PLAN_COUNT && strcmp(sweep_plans[p].bench, arg) != 0)
+                p++;
+            if (p == SWEEP_PLAN_COUNT) {
+                printf("Error: no sweep plan '%s', plans are memory_management and memory_access\n", arg);
+                return -1;
+            }
+            plans.push_back(&sweep_plans[p]);
+        }
+    }
+    if (plans.empty()) {
+        for (int p = 0; p < SWEEP_PLAN_COUNT; ++p)
+            plans.push_back(&sweep_plans[p]);
+    }
+    if (cpus.empty())
+        cpus.push_back(-1);
+    if (resume && output == NULL) {
+        printf("Error: --resume needs --output\n");
+        return -1;
+    }
+    if (sweep_drift <= 0.0 || sweep_max_cooldown < 0.0) {
+        printf("Error: need drift > 0 and max-cooldown >= 0\n");
+        return -1;
+    }
+
+    std::set<std::string> done;
+    FILE* journal = NULL;
+    if (output != NULL) {
+        std::string journal_path = std::string(output) + ".done";
+        if (resume)
+            sweep_load_done(journal_path, &done);
+        journal = fopen(journal_path.c_str(), resume ? "a" : "w");
+        if (journal == NULL || results_open(output, resume) < 0) {
+            printf("Error: cannot open '%s' or '%s'\n", output, journal_path.c_str());
+            if (journal != NULL)
+                fclose(journal);
+            return -1;
+        }
+        if (!done.empty())
+            printf("Info: resuming, %lu points already done\n", (unsigned long)done.size());
+    }
+
+    int failures = 0;
+    for (size_t c = 0; c < cpus.size(); ++c) {
+        if (cpus[c] >= 0)
+            sweep_set_cpu(cpus[c]);
+        double reference = sweep_probe();
+
+        for (size_t p = 0; p < plans.size(); ++p) {
+            for (const char** point = plans[p]->points; *point != NULL; ++point) {
+                char key[256];
+                snprintf(key, sizeof(key), "cpu=%d %s %s", cpus[c], plans[p]->bench, *point);
+                if (done.count(key))
+                    continue;
+
+                std::vector<std::string> set = split(*point, ' ');
+                std::vector<const char*> args;
+                for (size_t s = 0; s < set.size(); ++s)
+                    args.push_back(set[s].c_str());
+
+                sweep_cooldown(reference);
+                results_defer(1);
+                int ret = bench_run_with(plans[p]->bench, (int)args.size(), args.data());
+                if (ret == 0) {
+                    results_commit();
+                    if (journal != NULL) {
+                        fprintf(journal, "%s\n", key);
+                        fflush(journal);
+                        fsync(fileno(journal));
+                    }
+                } else {
+                    failures++;
+                }
+                results_defer(0);
+                bench_enclave_reset();
+            }
+        }
+    }
+
+    bench_enclave_release();
+    results_close();
+    if (journal != NULL)
+        fclose(journal);
+    if (failures)
+        printf("Error: %d point(s) failed, run again with --resume to retry them\n", failures);
+    return failures ? -1 : 0;
+}
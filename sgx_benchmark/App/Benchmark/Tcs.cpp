@@ -0,0 +1,174 @@
+/* Tcs.cpp - first ecall of a thread that needs a new TCS.
+ *
+ * Each round loads the enclave afresh and parks `pool` threads inside, which
+ * takes the static TCS (TCSNum). The urts keeps TCSMinPool TCS free and adds
+ * them in the background, so it waits TCS_SETTLE_US for that refill to end:
+ * then exactly TCSMinPool (= pool) TCS are free. A burst of threads enters
+ * at once and stays inside; the first `pool` of them find a pooled TCS, the
+ * rest need one added at run time. The enclave times how long each took to
+ * get in, the slowest burst - pool go to [tcs first ecall]. After they
+ * leave, a second burst of as many new threads enters the same way, now on
+ * the TCS the first one left in the pool: the steady state. The urts adds
+ * TCS one at a time, so the later threads of a burst wait for the earlier
+ * ones. Needs EDMM, TCSNum = TCSMinPool = pool and burst > pool.
+ */
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "sgx_urts.h"
+#include "../App.h"
+#include "Enclave_u.h"
+#include "histogram.h"
+
+#define TCS_SETTLE_US 50000  /* refilling TCSMinPool takes well under 1 ms */
+
+struct tcs_hold_t {
+    int entered;           /* threads inside, written by the enclave */
+    int stop;
+    std::atomic<int> failed;
+};
+
+static std::atomic<int> tcs_ready(0);
+static std::atomic<bool> tcs_go(false);
+
+static void tcs_thread(tcs_hold_t* hold, uint64_t* enter_cycles, bool wait)
+{
+    tcs_ready++;
+    while (wait && !tcs_go.load())
+        __builtin_ia32_pause();
+    int ret = -1;
+    uint64_t start_tsc = rdtsc();
+    if (ecall_tcs_hold(global_eid, &ret, start_tsc, enter_cycles, &hold->entered, &hold->stop) != SGX_SUCCESS ||
+        ret != 0)
+        hold->failed++;
+}
+
+/* Start nthreads threads holding a TCS each, return once all are inside or
+ * failed; the number that failed.
+ */
+static int tcs_enter(tcs_hold_t* hold, int nthreads, std::vector<uint64_t>* cycles,
+                     std::vector<std::thread>* threads, bool burst)
+{
+    __atomic_store_n(&hold->entered, 0, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&hold->stop, 0, __ATOMIC_SEQ_CST);
+    hold->failed = 0;
+    cycles->assign(nthreads, 0);
+    tcs_ready = 0;
+    tcs_go = false;
+    for (int t = 0; t < nthreads; ++t)
+        threads->push_back(std::thread(tcs_thread, hold, &(*cycles)[t], burst));
+    while (tcs_ready.load() < nthreads)
+        __builtin_ia32_pause();
+    tcs_go = true;
+    while (__atomic_load_n(&hold->entered, __ATOMIC_SEQ_CST) + hold->failed.load() < nthreads)
+        usleep(10);
+    return hold->failed.load();
+}
+
+static void tcs_leave(tcs_hold_t* hold, std::vector<std::thread>* threads)
+{
+    __atomic_store_n(&hold->stop, 1, __ATOMIC_SEQ_CST);
+    for (size_t t = 0; t < threads->size(); ++t)
+        (*threads)[t].join();
+    threads->clear();
+}
+
+/* The fastest `pooled` threads of the burst found a free TCS, the rest go
+ * to hist.
+ */
+static int tcs_burst(tcs_hold_t* hold, int burst, int pooled, histogram_t* hist)
+{
+    std::vector<uint64_t> cycles;
+    std::vector<std::thread> threads;
+    usleep(TCS_SETTLE_US);  /* the urts refills TCSMinPool in the background */
+    int failed = tcs_enter(hold, burst, &cycles, &threads, true);
+    tcs_leave(hold, &threads);
+    if (failed)
+        return -1;
+    std::sort(cycles.begin(), cycles.end());
+    for (int t = pooled; t < burst; ++t)
+        hist_record(hist, cycles[t]);
+    return 0;
+}
+
+static void print_tcs_hist(const char* name, int burst, const histogram_t* hist)
+{
+    char percentiles[256], label[96];
+    hist_format(hist, percentiles, sizeof(percentiles));
+    printf("%-30s [ burst: %d]    time is %lu ± %.0f cycles (%.1f ns), n=%lu, %s\n", name, burst,
+            (unsigned long)hist_mean(hist), hist_ci95(hist), timing_ns((double)hist_mean(hist)),
+            (unsigned long)hist->count, percentiles);
+    snprintf(label, sizeof(label), "%s burst %d", name, burst);
+    results_add_hist(label, "cycles", hist, 1.0);
+}
+
+/* tcs_create_benchmark:
+ *   bursts is a comma separated list of burst sizes, pool the number of
+ *   static TCS to occupy first and the TCSMinPool of config, rounds the
+ *   enclave loads per burst size.
+ */
+int tcs_create_benchmark(const char* config, const char* bursts, int pool, int rounds)
+{
+    std::vector<int> burst_sizes;
+    for (const char* p = bursts; p && *p; ) {
+        char* end = NULL;
+        long burst = strtol(p, &end, 0);
+        if (end == p || burst <= pool) {
+            printf("Error: bursts should be a list of thread counts > pool (%d), got '%s'\n", pool, bursts);
+            return -1;
+        }
+        burst_sizes.push_back((int)burst);
+        p = *end == ',' ? end + 1 : NULL;
+    }
+    if (pool < 0 || rounds < 1) {
+        printf("Error: need pool >= 0 and rounds >= 1\n");
+        return -1;
+    }
+
+    tcs_hold_t* parked = new tcs_hold_t();
+    tcs_hold_t* hold = new tcs_hold_t();
+    histogram_t* first = (histogram_t*)malloc(sizeof(histogram_t));
+    histogram_t* steady = (histogram_t*)malloc(sizeof(histogram_t));
+    int failures = 0;
+    for (size_t i = 0; i < burst_sizes.size(); ++i) {
+        int burst = burst_sizes[i];
+        int ret = 0;
+        hist_reset(first);
+        hist_reset(steady);
+        for (int r = 0; r < rounds && ret == 0; ++r) {
+            if (initialize_enclave(config) < 0) {
+                ret = -1;
+                break;
+            }
+            std::vector<uint64_t> parked_cycles;
+            std::vector<std::thread> parked_threads;
+            if (tcs_enter(parked, pool, &parked_cycles, &parked_threads, false) == 0) {
+                ret = tcs_burst(hold, burst, pool, first);
+                if (ret == 0)
+                    ret = tcs_burst(hold, burst, 0, steady);
+            } else {
+                ret = -1;
+            }
+            tcs_leave(parked, &parked_threads);
+            sgx_destroy_enclave(global_eid);
+        }
+        if (ret != 0) {
+            printf("Error: [tcs create] burst of %d failed (no EDMM, or pool + burst > TCSMaxNum)\n", burst);
+            failures++;
+            continue;
+        }
+        print_tcs_hist("[tcs first ecall]", burst, first);
+        print_tcs_hist("[tcs pooled ecall]", burst, steady);
+    }
+    free(first);
+    free(steady);
+    delete parked;
+    delete hold;
+    return failures ? -1 : 0;
+}
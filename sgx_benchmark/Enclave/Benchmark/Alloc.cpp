@@ -0,0 +1,169 @@
+/* Alloc.cpp - trusted side of the allocator benchmark */
+
+#include "../Enclave.h"
+#include "Enclave_t.h"
+#include "alloc_bench.h"
+#include "Slab.h"
+#include "sgx_spinlock.h"
+#include <string.h>
+
+#define ALLOC_MAX_THREADS 64
+
+/* the objects of every thread, allocated before the heap base is taken */
+static void** alloc_objects[ALLOC_MAX_THREADS];
+static int alloc_threads = 0;
+static int alloc_count = 0;
+
+static char* alloc_heap_base = NULL;
+static uint64_t alloc_live = 0;
+static sgx_spinlock_t alloc_sbrk_lock = SGX_SPINLOCK_INITIALIZER;
+
+static void* alloc_one(int kind, size_t size)
+{
+    switch (kind) {
+    case ALLOC_KIND_SLAB:
+        return slab_alloc(size);
+    case ALLOC_KIND_MALLOC:
+        return malloc(size);
+    default: {
+        /* keep objects 16-byte aligned like the other two */
+        sgx_spin_lock(&alloc_sbrk_lock);
+        void* p = sbrk((size + 15) & ~(size_t)15);
+        sgx_spin_unlock(&alloc_sbrk_lock);
+        return p == (void*)(~(size_t)0) ? NULL : p;
+    }
+    }
+}
+
+static void free_one(int kind, void* p)
+{
+    if (kind == ALLOC_KIND_SLAB)
+        slab_free(p);
+    else if (kind == ALLOC_KIND_MALLOC)
+        free(p);
+}
+
+/* slab: chunks handed out, malloc: the whole heap it holds (freed memory
+ * stays with it), sbrk: what the benchmark took since prepare
+ */
+static uint64_t alloc_footprint(int kind)
+{
+    if (kind == ALLOC_KIND_SLAB)
+        return slab_committed();
+    if (kind == ALLOC_KIND_MALLOC)
+        return enclave_heap_used();
+    return (uint64_t)((char*)sbrk(0) - alloc_heap_base);
+}
+
+static void alloc_free_objects(void)
+{
+    for (int t = 0; t < alloc_threads; ++t) {
+        free(alloc_objects[t]);
+        alloc_objects[t] = NULL;
+    }
+    alloc_threads = 0;
+}
+
+int ecall_alloc_prepare(int kind, int threads, int objects, size_t size)
+{
+    if (kind < 0 || kind >= ALLOC_KIND_COUNT || threads < 1 || threads > ALLOC_MAX_THREADS ||
+        objects < 2 || size < 1 || size > SLAB_MAX_SIZE / 2)
+        return -1;
+
+    alloc_free_objects();
+    for (int t = 0; t < threads; ++t) {
+        alloc_objects[t] = (void**)calloc(objects, sizeof(void*));
+        if (alloc_objects[t] == NULL)
+            return -1;
+        alloc_threads = t + 1;
+    }
+    alloc_count = objects;
+    alloc_live = 0;
+
+    if (kind == ALLOC_KIND_SLAB) {
+        /* the peak of a round, with a partly used chunk per class and thread */
+        size_t peak = (size_t)objects * size + (size_t)(objects / 2) * 2 * size;
+        return slab_init((size_t)threads * (peak * 2 + 4 * 64 * 1024));
+    }
+    alloc_heap_base = (char*)sbrk(0);
+    return 0;
+}
+
+int ecall_alloc_run(int kind, int thread, size_t size, int rounds, alloc_bench_stats_t* stats)
+{
+    if (thread < 0 || thread >= alloc_threads)
+        return -1;
+    void** objects = alloc_objects[thread];
+    int n = alloc_count;
+    int frees = kind != ALLOC_KIND_SBRK;  /* sbrk only allocates */
+    uint64_t start_tsc;
+
+    memset(stats, 0, sizeof(*stats));
+    for (int round = 0; round < rounds; ++round) {
+        start_tsc = rdtsc();
+        for (int i = 0; i < n; ++i) {
+            objects[i] = alloc_one(kind, size);
+            if (objects[i] == NULL)
+                return -1;
+            *(volatile char*)objects[i] = (char)i;
+        }
+        stats->alloc_cycles += timing_since(start_tsc);
+
+        if (frees) {
+            start_tsc = rdtsc();
+            for (int i = 1; i < n; i += 2)
+                free_one(kind, objects[i]);
+            stats->free_cycles += timing_since(start_tsc);
+        }
+
+        start_tsc = rdtsc();
+        for (int i = 1; i < n; i += 2) {
+            objects[i] = alloc_one(kind, 2 * size);
+            if (objects[i] == NULL)
+                return -1;
+            *(volatile char*)objects[i] = (char)i;
+        }
+        stats->alloc_cycles += timing_since(start_tsc);
+
+        uint64_t live = (uint64_t)n * size + (uint64_t)(n / 2) * size;
+        uint64_t all_live = __atomic_add_fetch(&alloc_live, live, __ATOMIC_RELAXED);
+        if (all_live >= stats->live_bytes) {
+            stats->live_bytes = all_live;
+            stats->footprint = alloc_footprint(kind);
+        }
+
+        if (frees) {
+            start_tsc = rdtsc();
+            if (kind == ALLOC_KIND_SLAB) {
+                slab_free_bulk(objects, n);
+            } else {
+                for (int i = 0; i < n; ++i)
+                    free_one(kind, objects[i]);
+            }
+            stats->free_cycles += timing_since(start_tsc);
+            stats->free_ops += n / 2 + n;
+        }
+        __atomic_sub_fetch(&alloc_live, live, __ATOMIC_RELAXED);
+
+        stats->alloc_ops += n + n / 2;
+    }
+    return 0;
+}
+
+void ecall_alloc_finish(int kind, int release)
+{
+    if (kind == ALLOC_KIND_SLAB) {
+        slab_reset();
+    } else if (kind == ALLOC_KIND_SBRK) {
+        /* nothing but the benchmark grew the heap since prepare */
+        char* top = (char*)sbrk(0);
+        if (top > alloc_heap_base)
+            sbrk(-(long)(top - alloc_heap_base));
+    }
+    alloc_live = 0;
+    if (release) {
+        if (kind == ALLOC_KIND_SLAB)
+            slab_release();
+        alloc_free_objects();
+    }
+}
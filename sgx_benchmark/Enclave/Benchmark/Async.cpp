@@ -0,0 +1,200 @@
+/* Async.cpp - asynchronous OCALLs with in-enclave continuation scheduling.
+ *
+ * A task is a step function the scheduler calls until it returns
+ * ASYNC_DONE. A step that posted an IO with async_submit returns ASYNC_WAIT,
+ * the completion's continuation puts the task back on the run queue. While
+ * the IO is in flight on a host worker, other tasks compute.
+ */
+
+#include "../Enclave.h"
+#include "Enclave_t.h"
+#include "rpc_ring.h"
+#include "Rpc.h"
+#include <string.h>
+
+#define ASYNC_MAX_TASKS RPC_MAX_PENDING
+
+#define ASYNC_YIELD 0 /* runnable again right away */
+#define ASYNC_WAIT  1 /* parked until its IO completes */
+#define ASYNC_DONE  2
+
+typedef struct _async_task_t async_task_t;
+typedef int (*async_step_t)(async_task_t* task);
+
+struct _async_task_t {
+    async_step_t step;
+    int64_t result; /* result of the last completed IO */
+};
+
+/* A task is either running, queued or waiting, so the run queue never
+ * holds more than ASYNC_MAX_TASKS entries.
+ */
+typedef struct _async_sched_t {
+    async_task_t* runq[ASYNC_MAX_TASKS];
+    int head;
+    int count;
+    int live;
+    int inflight;
+    int peak_inflight;
+} async_sched_t;
+
+static async_sched_t sched;
+
+static void async_ready(async_task_t* task)
+{
+    sched.runq[(sched.head + sched.count++) % ASYNC_MAX_TASKS] = task;
+}
+
+static async_task_t* async_next(void)
+{
+    async_task_t* task = sched.runq[sched.head];
+    sched.head = (sched.head + 1) % ASYNC_MAX_TASKS;
+    sched.count--;
+    return task;
+}
+
+static void async_resume(void* ctx, int64_t result)
+{
+    async_task_t* task = (async_task_t*)ctx;
+    task->result = result;
+    sched.inflight--;
+    async_ready(task);
+}
+
+/* Post an IO for task, returns -1 if it can not be posted right now */
+static int async_submit(async_task_t* task, uint32_t opcode, uint64_t arg, void* buf, uint32_t len)
+{
+    if (rpc_submit(opcode, arg, buf, len, async_resume, task) != 0)
+        return -1;
+    if (++sched.inflight > sched.peak_inflight)
+        sched.peak_inflight = sched.inflight;
+    return 0;
+}
+
+/* Run the tasks until all of them are done */
+static void async_run(async_task_t** tasks, int ntasks)
+{
+    sched.head = 0;
+    sched.count = 0;
+    sched.live = ntasks;
+    sched.inflight = 0;
+    sched.peak_inflight = 0;
+    for (int i = 0; i < ntasks; ++i)
+        async_ready(tasks[i]);
+
+    while (sched.live > 0) {
+        rpc_poll();
+        if (sched.count == 0) {
+            __builtin_ia32_pause();
+            continue;
+        }
+
+        async_task_t* task = async_next();
+        switch (task->step(task)) {
+        case ASYNC_YIELD:
+            async_ready(task);
+            break;
+        case ASYNC_WAIT:
+            break;
+        default:
+            sched.live--;
+            break;
+        }
+    }
+}
+
+/* Stand-in for real work */
+static void compute(uint64_t cycles)
+{
+    uint64_t start_tsc = rdtsc();
+    while (rdtsc() - start_tsc < cycles)
+        ;
+}
+
+typedef struct _bench_task_t {
+    async_task_t task; /* first, the scheduler hands out this pointer */
+    int steps_left;
+    int computed;
+    int io_posted;
+    uint64_t compute_cycles;
+    uint64_t io_cycles;
+} bench_task_t;
+
+static int bench_step(async_task_t* task)
+{
+    bench_task_t* b = (bench_task_t*)task;
+
+    if (b->io_posted) {
+        b->io_posted = 0;
+        if (--b->steps_left == 0)
+            return ASYNC_DONE;
+    }
+    if (!b->computed) {
+        compute(b->compute_cycles);
+        b->computed = 1;
+    }
+    /* ring or pending table full: let the others run and retry */
+    if (async_submit(task, RPC_OP_WAIT, b->io_cycles, NULL, 0) != 0)
+        return ASYNC_YIELD;
+    b->computed = 0;
+    b->io_posted = 1;
+    return ASYNC_WAIT;
+}
+
+static uint64_t run_overlapped(bench_task_t* tasks, int ntasks, int steps, uint64_t compute_cycles, uint64_t io_cycles)
+{
+    static async_task_t* list[ASYNC_MAX_TASKS];
+
+    for (int i = 0; i < ntasks; ++i) {
+        tasks[i].task.step = bench_step;
+        tasks[i].task.result = 0;
+        tasks[i].steps_left = steps;
+        tasks[i].computed = 0;
+        tasks[i].io_posted = 0;
+        tasks[i].compute_cycles = compute_cycles;
+        tasks[i].io_cycles = io_cycles;
+        list[i] = &tasks[i].task;
+    }
+
+    uint64_t start_tsc = rdtsc();
+    async_run(list, ntasks);
+    return rdtsc() - start_tsc;
+}
+
+int ecall_async_benchmark(int ntasks, int steps, uint64_t compute_cycles, uint64_t io_cycles, struct async_result_t* result)
+{
+    memset(result, 0, sizeof(*result));
+    if (!rpc_attached() || ntasks <= 0 || ntasks > ASYNC_MAX_TASKS || steps <= 0)
+        return -1;
+
+    bench_task_t* tasks = (bench_task_t*)malloc(ntasks * sizeof(bench_task_t));
+    if (tasks == NULL)
+        return -1;
+    uint64_t start_tsc;
+
+    start_tsc = rdtsc();
+    for (int i = 0; i < ntasks * steps; ++i)
+        compute(compute_cycles);
+    result->compute_only = rdtsc() - start_tsc;
+
+    start_tsc = rdtsc();
+    for (int i = 0; i < ntasks * steps; ++i) {
+        compute(compute_cycles);
+        ocall_async_wait(io_cycles);
+    }
+    result->ocall = rdtsc() - start_tsc;
+
+    start_tsc = rdtsc();
+    for (int i = 0; i < ntasks * steps; ++i) {
+        compute(compute_cycles);
+        rpc_call(RPC_OP_WAIT, io_cycles, NULL, 0);
+    }
+    result->rpc = rdtsc() - start_tsc;
+
+    result->io_only = run_overlapped(tasks, ntasks, steps, 0, io_cycles);
+    result->overlapped = run_overlapped(tasks, ntasks, steps, compute_cycles, io_cycles);
+    result->peak_inflight = sched.peak_inflight;
+
+    free(tasks);
+    return 0;
+}
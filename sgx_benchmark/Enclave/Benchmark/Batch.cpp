@@ -0,0 +1,57 @@
+/* Batch.cpp - trusted side of the batched ECALL */
+
+#include "../Enclave.h"
+#include "Enclave_t.h"
+#include "batch.h"
+
+static int64_t batch_execute(uint32_t opcode, uint64_t arg0, uint64_t arg1,
+                             uint8_t* payload, uint32_t payload_len)
+{
+    switch (opcode) {
+    case BATCH_OP_NOP:
+        return 0;
+    case BATCH_OP_ADD:
+        return (int64_t)(arg0 + arg1);
+    case BATCH_OP_CHECKSUM: {
+        int64_t sum = 0;
+        for (uint32_t i = 0; i < payload_len; ++i) sum += payload[i];
+        return sum;
+    }
+    case BATCH_OP_FILL:
+        for (uint32_t i = 0; i < payload_len; ++i) payload[i] = (uint8_t)arg0;
+        return (int64_t)payload_len;
+    default:
+        return BATCH_ERROR_OPCODE;
+    }
+}
+
+/* ecall_batch:
+ *   The buffer has already been copied into the enclave by the bridge, so
+ *   every header only needs to be checked against the buffer bounds.
+ */
+int ecall_batch(void* cmds, size_t size, int count)
+{
+    uint8_t* p = (uint8_t*)cmds;
+    size_t left = size;
+
+    for (int i = 0; i < count; ++i) {
+        if (left < sizeof(batch_cmd_t))
+            return -1;
+        batch_cmd_t* cmd = (batch_cmd_t*)p;
+        size_t cmd_size = batch_cmd_size(cmd->payload_len);
+        if (cmd_size > left)
+            return -1;
+
+        cmd->result = batch_execute(cmd->opcode, cmd->arg0, cmd->arg1,
+                                    batch_cmd_payload(cmd), cmd->payload_len);
+        p += cmd_size;
+        left -= cmd_size;
+    }
+    return count;
+}
+
+int64_t ecall_batch_op(uint32_t opcode, uint64_t arg0, uint64_t arg1,
+                       uint8_t* payload, uint32_t payload_len)
+{
+    return batch_execute(opcode, arg0, arg1, payload, payload_len);
+}
@@ -0,0 +1,76 @@
+/* Edmm.cpp - trusted side of the multi-threaded EDMM benchmark.
+ *
+ * Restricting permissions and freeing reserved memory have to flush the
+ * stale TLB entries of every thread inside the enclave (ETRACK, then the
+ * driver sends IPIs that force an AEX on the CPUs still running it). The
+ * more threads are inside, the more that costs; ecall_edmm_busy keeps
+ * threads inside without touching EDMM.
+ */
+
+#include "../Enclave.h"
+#include "Enclave_t.h"
+#include "histogram.h"
+#include "sgx_lfence.h"
+#include "sgx_trts.h"
+
+#define EDMM_STEPS 4 /* alloc, touch, restrict, free */
+
+int ecall_edmm_worker(int page_num, int iterations, histogram_t* hists, int nhists)
+{
+    size_t size = (size_t)page_num * 4096;
+    uint64_t start_tsc;
+
+    if (nhists != EDMM_STEPS || page_num < 1)
+        return -1;
+    for (int h = 0; h < nhists; ++h)
+        hist_reset(&hists[h]);
+
+    for (int i = 0; i < iterations; ++i) {
+        start_tsc = rdtsc();
+        char* p = (char*)sgx_alloc_rsrv_mem(size);
+        uint64_t cycles = timing_since(start_tsc);
+        if (p == NULL)
+            return -1;
+        hist_record(&hists[0], cycles);
+
+        start_tsc = rdtsc();
+        for (char* ch_ptr = p; ch_ptr < p + size; ch_ptr += 4096) *(volatile char*)ch_ptr = 'a';
+        hist_record(&hists[1], timing_since(start_tsc));
+
+        start_tsc = rdtsc();
+        sgx_status_t status = sgx_tprotect_rsrv_mem(p, size, SGX_PROT_READ);
+        cycles = timing_since(start_tsc);
+        if (status != SGX_SUCCESS) {
+            sgx_free_rsrv_mem(p, size);
+            return -1;
+        }
+        hist_record(&hists[2], cycles);
+
+        start_tsc = rdtsc();
+        int ret = sgx_free_rsrv_mem(p, size);
+        cycles = timing_since(start_tsc);
+        if (ret != 0)
+            return -1;
+        hist_record(&hists[3], cycles);
+    }
+    return 0;
+}
+
+long ecall_edmm_busy(int* stop, int* entered)
+{
+    static __thread uint64_t work[8];
+    long loops = 0;
+    if (sgx_is_outside_enclave(stop, sizeof(int)) != 1 || sgx_is_outside_enclave(entered, sizeof(int)) != 1)
+        return -1;
+    /* fence after sgx_is_outside_enclave check */
+    sgx_lfence();
+
+    __atomic_add_fetch(entered, 1, __ATOMIC_SEQ_CST);
+    while (*(volatile int*)stop == 0) {
+        for (int i = 0; i < 64; ++i)
+            work[i & 7] += (uint64_t)i;
+        __builtin_ia32_pause();
+        loops++;
+    }
+    return loops;
+}
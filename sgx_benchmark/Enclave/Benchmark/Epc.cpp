@@ -0,0 +1,54 @@
+/* Epc.cpp - trusted side of the EPC oversubscription sweep.
+ *
+ * The buffer comes from reserved memory, so the enclave heap does not have
+ * to be sized for the largest point. Once it no longer fits the EPC, a touch
+ * of an evicted page costs a #PF, an AEX and the driver's EWB of some other
+ * page plus the ELDU of this one.
+ */
+
+#include "../Enclave.h"
+#include "Enclave_t.h"
+
+static char* epc_buf = NULL;
+static size_t epc_bytes = 0;
+
+void ecall_epc_release(void)
+{
+    if (epc_buf != NULL && sgx_free_rsrv_mem(epc_buf, epc_bytes) == 0) {
+        epc_buf = NULL;
+        epc_bytes = 0;
+    }
+}
+
+int ecall_epc_prepare(size_t bytes)
+{
+    ecall_epc_release();
+    if (epc_buf != NULL)
+        return -1;
+    bytes = (bytes + 4095) & ~(size_t)4095;
+    epc_buf = (char*)sgx_alloc_rsrv_mem(bytes);
+    if (epc_buf == NULL)
+        return -1;
+    epc_bytes = bytes;
+    for (char* p = epc_buf; p < epc_buf + bytes; p += 4096)
+        *(volatile char*)p = 1;
+    return 0;
+}
+
+uint64_t ecall_epc_touch(long accesses, uint64_t seed)
+{
+    if (epc_buf == NULL)
+        return 0;
+    uint64_t pages = epc_bytes / 4096;
+    uint64_t x = seed | 1;
+
+    uint64_t start_tsc = rdtsc();
+    for (long i = 0; i < accesses; ++i) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        uint64_t page = (x >> 6) % pages;
+        (*(volatile uint64_t*)(epc_buf + page * 4096 + (x & 63) * 64))++;
+    }
+    return timing_since(start_tsc);
+}
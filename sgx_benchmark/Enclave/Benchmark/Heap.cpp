@@ -0,0 +1,69 @@
+/* Heap.cpp - trusted side of the heap growth benchmark.
+ *
+ * tlibc malloc grows the heap with sbrk. Beyond HeapMinSize, with EDMM, every
+ * sbrk that crosses into uncommitted heap adds and accepts the new pages
+ * before it returns, so the malloc that moved the break pays for all of them.
+ * The objects are chained through their first bytes and the result is built
+ * in a static buffer, nothing else is allocated on the heap.
+ */
+
+#include "../Enclave.h"
+#include "Enclave_t.h"
+#include "heap_growth.h"
+#include "sgx_lfence.h"
+#include "sgx_trts.h"
+#include <string.h>
+
+struct heap_object_t {
+    heap_object_t* next;
+};
+
+static heap_growth_t heap_result;
+
+int ecall_heap_growth(size_t object_size, size_t total_bytes, heap_growth_t* out)
+{
+    heap_growth_t* result = &heap_result;
+    heap_object_t* head = NULL;
+    uint64_t start_tsc;
+
+    if (object_size < sizeof(heap_object_t) || sgx_is_outside_enclave(out, sizeof(*out)) != 1)
+        return -1;
+    /* fence after sgx_is_outside_enclave check */
+    sgx_lfence();
+
+    memset(result, 0, sizeof(*result));
+    hist_reset(&result->all);
+    hist_reset(&result->growth);
+
+    char* brk = (char*)sbrk(0);
+    result->heap_start = (uint64_t)(uintptr_t)brk;
+    for (size_t done = 0; done < total_bytes; done += object_size) {
+        start_tsc = rdtsc();
+        heap_object_t* obj = (heap_object_t*)malloc(object_size);
+        if (obj != NULL)
+            obj->next = head;
+        uint64_t cycles = timing_since(start_tsc);
+        if (obj == NULL)
+            break;
+        head = obj;
+
+        hist_record(&result->all, cycles);
+        if (result->objects++ == 0)
+            result->first_byte = cycles;
+        char* now = (char*)sbrk(0);
+        if (now != brk) {
+            hist_record(&result->growth, cycles);
+            result->steps++;
+            brk = now;
+        }
+    }
+    result->heap_end = (uint64_t)(uintptr_t)brk;
+
+    while (head != NULL) {
+        heap_object_t* next = head->next;
+        free(head);
+        head = next;
+    }
+    memcpy(out, result, sizeof(*out));
+    return result->objects ? 0 : -1;
+}
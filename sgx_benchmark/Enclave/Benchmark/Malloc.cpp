@@ -0,0 +1,35 @@
+/* Malloc.cpp - trusted side of the malloc benchmark.
+ *
+ * tlibc malloc takes its memory from the enclave heap with sbrk and never
+ * gives it back, so the heap below the break (enclave_heap_used) is its
+ * footprint: with EDMM, the EPC pages it committed.
+ */
+
+#include "../Enclave.h"
+#include "Enclave_t.h"
+#include "malloc_bench.h"
+#include "sgx_lfence.h"
+#include "sgx_trts.h"
+
+static malloc_bench_t malloc_bench;
+
+int ecall_malloc_bench_setup(int mcase, int nthreads, size_t size, long ops, int* abort)
+{
+    malloc_bench_teardown(&malloc_bench);
+    if (sgx_is_outside_enclave(abort, sizeof(int)) != 1)
+        return -1;
+    /* fence after sgx_is_outside_enclave check */
+    sgx_lfence();
+    return malloc_bench_setup(&malloc_bench, mcase, nthreads, size, ops, enclave_heap_used, abort);
+}
+
+long ecall_malloc_bench_thread(int thread, int trial)
+{
+    return malloc_bench_thread(&malloc_bench, thread, trial);
+}
+
+uint64_t ecall_malloc_bench_teardown(void)
+{
+    malloc_bench_teardown(&malloc_bench);
+    return malloc_bench.peak;
+}
@@ -0,0 +1,19 @@
+/* Nested.cpp - trusted side of the nested OCALL -> ECALL benchmark */
+
+#include "../Enclave.h"
+#include "Enclave_t.h"
+
+/* ecall_nested_enter, ecall_nested:
+ *   Each level with depth > 0 goes back out through ocall_nested, whose
+ *   untrusted side re-enters with ecall_nested(depth - 1).
+ */
+void ecall_nested_enter(int depth, long* buf, int len)
+{
+    if (depth > 0 && ocall_nested(depth, buf, len) != SGX_SUCCESS)
+        abort();
+}
+
+void ecall_nested(int depth, long* buf, int len)
+{
+    ecall_nested_enter(depth, buf, len);
+}
@@ -0,0 +1,269 @@
+/* Rpc.cpp - enclave side of the exitless RPC engine.
+ *
+ * The enclave posts requests to a ring in untrusted memory and polls a
+ * second ring for the completion, host workers execute the requests.
+ * No EEXIT happens unless a worker fell asleep on its futex.
+ */
+
+#include "../Enclave.h"
+#include "Enclave_t.h"
+#include "histogram.h"
+#include "rpc_ring.h"
+#include "sgx_spinlock.h"
+#include "sgx_trts.h"
+#include "Rpc.h"
+#include <string.h>
+
+#define RPC_MAX_CAPACITY     (1 << 20)
+#define RPC_MAX_PAYLOAD_SIZE (1 << 24)
+
+static rpc_ring_ref_t rpc_req;
+static rpc_ring_ref_t rpc_cpl;
+static int rpc_policy = RPC_POLL_PAUSE;
+static uint64_t rpc_next_id = 0;
+static int rpc_ready = 0;
+/* Guards everything below and the rings' attachment: any enclave thread may
+ * submit and poll. Continuations run without it, they may submit again.
+ */
+static sgx_spinlock_t rpc_lock = SGX_SPINLOCK_INITIALIZER;
+
+/* In-flight requests. msg.id carries the table index in its low bits and a
+ * generation above, so a stale or forged completion id is rejected.
+ */
+typedef struct _rpc_pending_t {
+    uint64_t id;
+    int in_use;
+    void* buf;
+    uint32_t out_len;
+    rpc_continuation_t continuation;
+    void* ctx;
+} rpc_pending_t;
+
+static rpc_pending_t rpc_table[RPC_MAX_PENDING];
+static int rpc_free_list[RPC_MAX_PENDING];
+static int rpc_free_count = -1;
+static uint8_t* rpc_scratch = NULL;
+
+int ecall_rpc_setup(void* req_ring, void* cpl_ring, uint64_t capacity, uint64_t payload_size, int policy)
+{
+    if (capacity == 0 || capacity > RPC_MAX_CAPACITY || (capacity & (capacity - 1)) != 0)
+        return -1;
+    if (payload_size > RPC_MAX_PAYLOAD_SIZE)
+        return -1;
+    if (policy < RPC_POLL_SPIN || policy > RPC_POLL_FUTEX)
+        return -1;
+
+    size_t bytes = (size_t)rpc_ring_bytes(capacity, payload_size);
+    if (sgx_is_outside_enclave(req_ring, bytes) != 1 || sgx_is_outside_enclave(cpl_ring, bytes) != 1)
+        return -1;
+
+    sgx_spin_lock(&rpc_lock);
+    /* no requests in flight on the rings attached before */
+    int busy = rpc_free_count >= 0 && rpc_free_count != RPC_MAX_PENDING;
+    uint8_t* scratch = busy ? NULL : (uint8_t*)realloc(rpc_scratch, payload_size ? payload_size : 1);
+    if (scratch == NULL) {
+        sgx_spin_unlock(&rpc_lock);
+        return -1;
+    }
+    rpc_scratch = scratch;
+
+    rpc_ring_ref_init(&rpc_req, req_ring, capacity, payload_size);
+    rpc_ring_ref_init(&rpc_cpl, cpl_ring, capacity, payload_size);
+    rpc_policy = policy;
+    __atomic_store_n(&rpc_ready, 1, __ATOMIC_RELEASE);
+    sgx_spin_unlock(&rpc_lock);
+    return 0;
+}
+
+void ecall_rpc_detach(void)
+{
+    sgx_spin_lock(&rpc_lock);
+    __atomic_store_n(&rpc_ready, 0, __ATOMIC_RELEASE);
+    memset(&rpc_req, 0, sizeof(rpc_req));
+    memset(&rpc_cpl, 0, sizeof(rpc_cpl));
+    memset(rpc_table, 0, sizeof(rpc_table));
+    rpc_free_count = -1;
+    sgx_spin_unlock(&rpc_lock);
+}
+
+int rpc_attached(void)
+{
+    return __atomic_load_n(&rpc_ready, __ATOMIC_ACQUIRE);
+}
+
+/* rpc_lock held */
+static int rpc_alloc_pending(void)
+{
+    if (rpc_free_count < 0) {
+        for (int i = 0; i < RPC_MAX_PENDING; ++i)
+            rpc_free_list[i] = RPC_MAX_PENDING - 1 - i;
+        rpc_free_count = RPC_MAX_PENDING;
+    }
+    return rpc_free_count > 0 ? rpc_free_list[--rpc_free_count] : -1;
+}
+
+static void rpc_free_pending(int idx)
+{
+    rpc_table[idx].in_use = 0;
+    rpc_free_list[rpc_free_count++] = idx;
+}
+
+static void rpc_notify(void)
+{
+    /* make the request visible before looking for sleeping workers */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (rpc_policy == RPC_POLL_FUTEX && __atomic_load_n(&rpc_req.ring->sleepers, __ATOMIC_RELAXED) > 0) {
+        __atomic_fetch_add(&rpc_req.ring->futex_word, 1, __ATOMIC_SEQ_CST);
+        ocall_rpc_wake(rpc_req.ring);
+    }
+}
+
+/* the payload of an IN request or an OUT reply has to fit in one slot */
+static int rpc_fits(uint32_t opcode, uint32_t len)
+{
+    return (opcode != RPC_OP_IN && opcode != RPC_OP_OUT) || len <= rpc_req.payload_size;
+}
+
+int rpc_submit(uint32_t opcode, uint64_t arg, void* buf, uint32_t len,
+               rpc_continuation_t continuation, void* ctx)
+{
+    sgx_spin_lock(&rpc_lock);
+    int idx = rpc_ready && rpc_fits(opcode, len) ? rpc_alloc_pending() : -1;
+    if (idx < 0) {
+        sgx_spin_unlock(&rpc_lock);
+        return -1;
+    }
+
+    rpc_msg_t msg;
+    msg.id = (++rpc_next_id << 8) | (uint64_t)idx;
+    msg.opcode = opcode;
+    msg.len = 0;
+    msg.out_len = opcode == RPC_OP_OUT ? len : 0;
+    msg.reserved = 0;
+    msg.arg = arg;
+    msg.result = 0;
+
+    uint32_t in_len = opcode == RPC_OP_IN ? len : 0;
+    rpc_pending_t* p = &rpc_table[idx];
+    p->id = msg.id;
+    p->in_use = 1;
+    p->buf = buf;
+    p->out_len = msg.out_len;
+    p->continuation = continuation;
+    p->ctx = ctx;
+    if (!rpc_try_enqueue(&rpc_req, &msg, buf, in_len)) {
+        rpc_free_pending(idx);
+        sgx_spin_unlock(&rpc_lock);
+        return -1;
+    }
+    sgx_spin_unlock(&rpc_lock);
+
+    rpc_notify();
+    return 0;
+}
+
+int rpc_poll(void)
+{
+    int harvested = 0;
+    rpc_msg_t cpl;
+
+    for (;;) {
+        sgx_spin_lock(&rpc_lock);
+        if (!rpc_ready || !rpc_try_dequeue(&rpc_cpl, &cpl, rpc_scratch, (uint32_t)rpc_cpl.payload_size)) {
+            sgx_spin_unlock(&rpc_lock);
+            break;
+        }
+        int idx = (int)(cpl.id & (RPC_MAX_PENDING - 1));
+        rpc_pending_t* p = &rpc_table[idx];
+        /* a reply that does not carry what was asked for is as bad as a forged id */
+        if (!p->in_use || p->id != cpl.id || cpl.len != p->out_len)
+            abort();
+
+        if (p->out_len)
+            memcpy(p->buf, rpc_scratch, p->out_len);
+
+        rpc_continuation_t continuation = p->continuation;
+        void* ctx = p->ctx;
+        rpc_free_pending(idx);
+        sgx_spin_unlock(&rpc_lock);
+        if (continuation)
+            continuation(ctx, cpl.result);
+        harvested++;
+    }
+    return harvested;
+}
+
+int rpc_pending(void)
+{
+    sgx_spin_lock(&rpc_lock);
+    int pending = rpc_free_count < 0 ? 0 : RPC_MAX_PENDING - rpc_free_count;
+    sgx_spin_unlock(&rpc_lock);
+    return pending;
+}
+
+typedef struct _rpc_sync_t {
+    int done;
+    int64_t result;
+} rpc_sync_t;
+
+static void rpc_sync_done(void* ctx, int64_t result)
+{
+    rpc_sync_t* sync = (rpc_sync_t*)ctx;
+    sync->result = result;
+    __atomic_store_n(&sync->done, 1, __ATOMIC_RELEASE);
+}
+
+/* rpc_call:
+ *   Synchronous RPC on top of rpc_submit. For RPC_OP_IN, len bytes of buf
+ *   go to the host, for RPC_OP_OUT, up to len bytes come back into buf.
+ */
+int64_t rpc_call(uint32_t opcode, uint64_t arg, void* buf, uint32_t len)
+{
+    rpc_sync_t sync = { 0, 0 };
+
+    /* a request that never fits would be retried forever */
+    if (!rpc_attached() || !rpc_fits(opcode, len))
+        return -1;
+    while (rpc_submit(opcode, arg, buf, len, rpc_sync_done, &sync) != 0) {
+        rpc_poll();
+        rpc_poll_backoff(rpc_policy);
+    }
+    /* any thread polling may run the continuation */
+    while (!__atomic_load_n(&sync.done, __ATOMIC_ACQUIRE)) {
+        if (rpc_poll() == 0)
+            rpc_poll_backoff(rpc_policy);
+    }
+    return sync.result;
+}
+
+static void rpc_loop(uint32_t opcode, int loops, int len, histogram_t* hist)
+{
+    hist_reset(hist);
+    if (!rpc_attached())
+        return;
+
+    uint32_t bytes = (uint32_t)len * sizeof(long);
+    long* ptr = (long*)malloc(bytes ? bytes : sizeof(long));
+    assert(ptr != NULL);
+    for (int i = 0; i < loops; i++) {
+        uint64_t start_tsc = rdtsc();
+        rpc_call(opcode, (uint64_t)i, ptr, bytes);
+        hist_record(hist, timing_since(start_tsc));
+    }
+    free(ptr);
+}
+
+void ecall_rpc_void(int loops, histogram_t* hist)
+{
+    rpc_loop(RPC_OP_VOID, loops, 0, hist);
+}
+
+void ecall_rpc_in(int loops, int len, histogram_t* hist)
+{
+    rpc_loop(RPC_OP_IN, loops, len, hist);
+}
+
+void ecall_rpc_out(int loops, int len, histogram_t* hist)
+{
+    rpc_loop(RPC_OP_OUT, loops, len, hist);
+}
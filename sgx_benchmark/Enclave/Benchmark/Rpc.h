@@ -0,0 +1,39 @@
+/* Rpc.h - enclave-side API of the exitless RPC engine */
+
+#ifndef _BENCHMARK_RPC_H_
+#define _BENCHMARK_RPC_H_
+
+#include <stdint.h>
+
+/* Up to RPC_MAX_PENDING requests may be in flight at once. Any number of
+ * enclave threads may submit and poll, a completion's continuation runs on
+ * whichever thread harvested it.
+ */
+#define RPC_MAX_PENDING 256
+
+/* Runs inside rpc_poll() when the completion of an async request arrives */
+typedef void (*rpc_continuation_t)(void* ctx, int64_t result);
+
+/* 1 once ecall_rpc_setup attached the rings */
+int rpc_attached(void);
+
+/* Synchronous RPC, returns the result set by the host worker, -1 when no
+ * rings are attached
+ */
+int64_t rpc_call(uint32_t opcode, uint64_t arg, void* buf, uint32_t len);
+
+/* Asynchronous RPC: returns 0 once the request is posted, -1 if the ring
+ * or the pending table is full, len is over the payload size or no rings
+ * are attached. For RPC_OP_OUT, buf must stay valid until the continuation
+ * ran.
+ */
+int rpc_submit(uint32_t opcode, uint64_t arg, void* buf, uint32_t len,
+               rpc_continuation_t continuation, void* ctx);
+
+/* Harvest available completions and run their continuations, returns how many */
+int rpc_poll(void);
+
+/* Number of requests still in flight */
+int rpc_pending(void);
+
+#endif /* !_BENCHMARK_RPC_H_ */
@@ -0,0 +1,251 @@
+/* Slab.cpp - size-class allocator on pre-committed reserved memory.
+ *
+ * Classes are 16, 32, ... 4096 bytes. Every class keeps a central free list
+ * and the unused tail of its current chunk under a spinlock; a thread
+ * allocates from its own cache and refills or drains it SLAB_BATCH objects
+ * at a time. The class of an object is found from its chunk index, objects
+ * carry no header.
+ */
+
+#include "../Enclave.h"
+#include "Slab.h"
+#include "sgx_spinlock.h"
+#include <string.h>
+
+#define SLAB_MIN_SHIFT  4                   /* 16 bytes */
+#define SLAB_CLASSES    9                   /* up to SLAB_MAX_SIZE */
+#define SLAB_CHUNK_SIZE (64 * 1024)
+#define SLAB_CACHE_MAX  64                  /* objects per class in a thread cache */
+#define SLAB_BATCH      32                  /* objects moved per refill / drain */
+
+struct slab_object_t {
+    slab_object_t* next;
+};
+
+struct slab_class_t {
+    sgx_spinlock_t lock;
+    slab_object_t* free;
+    char* bump;                             /* unused tail of the current chunk */
+    char* end;
+};
+
+struct slab_cache_t {
+    uint64_t generation;                    /* stale after slab_reset */
+    slab_object_t* head[SLAB_CLASSES];
+    int count[SLAB_CLASSES];
+};
+
+static char* slab_base = NULL;
+static size_t slab_size = 0;
+static size_t slab_chunks = 0;              /* chunks handed out */
+static unsigned char* slab_chunk_class = NULL;
+static sgx_spinlock_t slab_arena_lock = SGX_SPINLOCK_INITIALIZER;
+static slab_class_t slab_classes[SLAB_CLASSES];
+static uint64_t slab_generation = 1;
+
+static __thread slab_cache_t slab_cache;
+
+static inline int slab_class_of(size_t size)
+{
+    if (size <= ((size_t)1 << SLAB_MIN_SHIFT))
+        return 0;
+    return 64 - __builtin_clzll((unsigned long long)(size - 1)) - SLAB_MIN_SHIFT;
+}
+
+static inline size_t slab_object_size(int c)
+{
+    return (size_t)1 << (c + SLAB_MIN_SHIFT);
+}
+
+static inline slab_cache_t* slab_thread_cache(void)
+{
+    slab_cache_t* cache = &slab_cache;
+    uint64_t generation = __atomic_load_n(&slab_generation, __ATOMIC_ACQUIRE);
+    if (cache->generation != generation) {
+        memset(cache, 0, sizeof(*cache));
+        cache->generation = generation;
+    }
+    return cache;
+}
+
+/* A fresh chunk for class c, NULL when the arena is used up */
+static char* slab_new_chunk(int c)
+{
+    char* chunk = NULL;
+    sgx_spin_lock(&slab_arena_lock);
+    if ((slab_chunks + 1) * SLAB_CHUNK_SIZE <= slab_size) {
+        slab_chunk_class[slab_chunks] = (unsigned char)c;
+        chunk = slab_base + slab_chunks * SLAB_CHUNK_SIZE;
+        slab_chunks++;
+    }
+    sgx_spin_unlock(&slab_arena_lock);
+    return chunk;
+}
+
+/* Move up to SLAB_BATCH objects of class c into the cache, returns how many */
+static int slab_refill(slab_cache_t* cache, int c)
+{
+    slab_class_t* cls = &slab_classes[c];
+    size_t size = slab_object_size(c);
+    int moved = 0;
+
+    sgx_spin_lock(&cls->lock);
+    while (moved < SLAB_BATCH) {
+        slab_object_t* obj = cls->free;
+        if (obj != NULL) {
+            cls->free = obj->next;
+        } else {
+            if (cls->bump + size > cls->end) {
+                char* chunk = slab_new_chunk(c);
+                if (chunk == NULL)
+                    break;
+                cls->bump = chunk;
+                cls->end = chunk + SLAB_CHUNK_SIZE;
+            }
+            obj = (slab_object_t*)cls->bump;
+            cls->bump += size;
+        }
+        obj->next = cache->head[c];
+        cache->head[c] = obj;
+        moved++;
+    }
+    sgx_spin_unlock(&cls->lock);
+    cache->count[c] += moved;
+    return moved;
+}
+
+/* Give SLAB_BATCH objects of an overfull cache back to class c */
+static void slab_drain(slab_cache_t* cache, int c)
+{
+    slab_object_t* first = cache->head[c];
+    slab_object_t* last = first;
+    for (int i = 1; i < SLAB_BATCH; ++i)
+        last = last->next;
+    cache->head[c] = last->next;
+    cache->count[c] -= SLAB_BATCH;
+
+    slab_class_t* cls = &slab_classes[c];
+    sgx_spin_lock(&cls->lock);
+    last->next = cls->free;
+    cls->free = first;
+    sgx_spin_unlock(&cls->lock);
+}
+
+static inline int slab_class_of_object(void* p)
+{
+    return slab_chunk_class[((char*)p - slab_base) / SLAB_CHUNK_SIZE];
+}
+
+int slab_init(size_t arena_bytes)
+{
+    size_t size = (arena_bytes + SLAB_CHUNK_SIZE - 1) / SLAB_CHUNK_SIZE * SLAB_CHUNK_SIZE;
+    if (slab_base != NULL && slab_size >= size) {
+        slab_reset();
+        return 0;
+    }
+    if (slab_release() != 0)
+        return -1;
+
+    slab_chunk_class = (unsigned char*)malloc(size / SLAB_CHUNK_SIZE);
+    slab_base = (char*)sgx_alloc_rsrv_mem(size);
+    if (slab_base == NULL || slab_chunk_class == NULL) {
+        printf("Error: slab arena of %lu bytes not available\n", (unsigned long)size);
+        if (slab_base != NULL)
+            sgx_free_rsrv_mem(slab_base, size);
+        free(slab_chunk_class);
+        slab_base = NULL;
+        slab_chunk_class = NULL;
+        return -1;
+    }
+    /* commit every page now, not on the first allocation */
+    for (char* p = slab_base; p < slab_base + size; p += 4096)
+        *(volatile char*)p = 0;
+    slab_size = size;
+    slab_reset();
+    return 0;
+}
+
+void* slab_alloc(size_t size)
+{
+    if (size > SLAB_MAX_SIZE || slab_base == NULL)
+        return NULL;
+    int c = slab_class_of(size);
+    slab_cache_t* cache = slab_thread_cache();
+    if (cache->head[c] == NULL && slab_refill(cache, c) == 0)
+        return NULL;
+    slab_object_t* obj = cache->head[c];
+    cache->head[c] = obj->next;
+    cache->count[c]--;
+    return obj;
+}
+
+void slab_free(void* p)
+{
+    if (p == NULL)
+        return;
+    int c = slab_class_of_object(p);
+    slab_cache_t* cache = slab_thread_cache();
+    slab_object_t* obj = (slab_object_t*)p;
+    obj->next = cache->head[c];
+    cache->head[c] = obj;
+    if (++cache->count[c] > SLAB_CACHE_MAX)
+        slab_drain(cache, c);
+}
+
+void slab_free_bulk(void** ptrs, int n)
+{
+    slab_object_t* first[SLAB_CLASSES] = { NULL };
+    slab_object_t* last[SLAB_CLASSES] = { NULL };
+
+    for (int i = 0; i < n; ++i) {
+        if (ptrs[i] == NULL)
+            continue;
+        int c = slab_class_of_object(ptrs[i]);
+        slab_object_t* obj = (slab_object_t*)ptrs[i];
+        obj->next = first[c];
+        if (first[c] == NULL)
+            last[c] = obj;
+        first[c] = obj;
+    }
+    for (int c = 0; c < SLAB_CLASSES; ++c) {
+        if (first[c] == NULL)
+            continue;
+        slab_class_t* cls = &slab_classes[c];
+        sgx_spin_lock(&cls->lock);
+        last[c]->next = cls->free;
+        cls->free = first[c];
+        sgx_spin_unlock(&cls->lock);
+    }
+}
+
+void slab_reset(void)
+{
+    sgx_spin_lock(&slab_arena_lock);
+    for (int c = 0; c < SLAB_CLASSES; ++c) {
+        slab_classes[c].free = NULL;
+        slab_classes[c].bump = NULL;
+        slab_classes[c].end = NULL;
+    }
+    slab_chunks = 0;
+    __atomic_add_fetch(&slab_generation, 1, __ATOMIC_RELEASE);
+    sgx_spin_unlock(&slab_arena_lock);
+}
+
+int slab_release(void)
+{
+    if (slab_base == NULL)
+        return 0;
+    slab_reset();
+    if (sgx_free_rsrv_mem(slab_base, slab_size) != 0)
+        return -1;
+    free(slab_chunk_class);
+    slab_base = NULL;
+    slab_size = 0;
+    slab_chunk_class = NULL;
+    return 0;
+}
+
+size_t slab_committed(void)
+{
+    return slab_chunks * SLAB_CHUNK_SIZE;
+}
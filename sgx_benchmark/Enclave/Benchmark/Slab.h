@@ -0,0 +1,38 @@
+/* Slab.h - size-class allocator on pre-committed reserved memory.
+ *
+ * slab_init reserves one arena with sgx_alloc_rsrv_mem and touches all of
+ * it, so under EDMM every page is committed before the first allocation.
+ * The arena is cut into chunks, each serving one size class; freed objects
+ * go back to their class and are reused, pages are never returned. The hot
+ * path (a per-thread cache) never takes a lock and never faults in a page.
+ *
+ * slab_reset and slab_release need all other threads out of the allocator.
+ */
+
+#ifndef _BENCHMARK_SLAB_H_
+#define _BENCHMARK_SLAB_H_
+
+#include <stddef.h>
+
+#define SLAB_MAX_SIZE 4096 /* larger requests fail */
+
+/* Reserve and commit an arena of at least arena_bytes, 0 on success */
+int slab_init(size_t arena_bytes);
+
+/* NULL when size > SLAB_MAX_SIZE or the arena is used up */
+void* slab_alloc(size_t size);
+void slab_free(void* p);
+
+/* Free n objects with one lock per size class */
+void slab_free_bulk(void** ptrs, int n);
+
+/* Free every object at once, the pages stay committed for the next ones */
+void slab_reset(void);
+
+/* Give the arena back, 0 on success or when there is none */
+int slab_release(void);
+
+/* Bytes of the chunks handed to the size classes */
+size_t slab_committed(void);
+
+#endif /* !_BENCHMARK_SLAB_H_ */
@@ -0,0 +1,62 @@
+/* Stack.cpp - trusted side of the stack growth benchmark.
+ *
+ * A thread on a TCS added at run time (beyond TCSMinPool) starts with
+ * StackMinSize of committed stack. With EDMM, the first touch of every page
+ * below it faults, and the exception handler accepts a new page before the
+ * write is retried. stack_descend allocas the whole depth and writes to it
+ * one page at a time from the top down, the way a deep call chain grows the
+ * stack, timing each write. Nothing is called inside the loop, a call frame
+ * would touch the pages below first, and the Makefile builds this file
+ * without stack clash protection, whose probes would touch them all in the
+ * alloca. Pages within `committed` bytes of the stack pointer at the ecall
+ * are part of StackMinSize and left out.
+ */
+
+#include "../Enclave.h"
+#include "Enclave_t.h"
+#include "histogram.h"
+
+#define STACK_PAGE 4096
+
+/* cycles[i] is the write to the i-th page from the top, at address[i] */
+static __attribute__((noinline)) void stack_descend(size_t pages, uint64_t* cycles, uintptr_t* address)
+{
+    volatile char* stack = (volatile char*)__builtin_alloca(pages * STACK_PAGE);
+    for (size_t i = 0; i < pages; ++i) {
+        volatile char* page = stack + (pages - 1 - i) * STACK_PAGE;
+        uint64_t start_tsc = rdtsc();
+        *page = (char)i;
+        cycles[i] = timing_since(start_tsc);
+        address[i] = (uintptr_t)page;
+    }
+}
+
+static void stack_hist(const uint64_t* cycles, const uintptr_t* address, size_t pages, uintptr_t grown_below,
+                       histogram_t* hist)
+{
+    hist_reset(hist);
+    for (size_t i = 0; i < pages; ++i) {
+        if (address[i] < grown_below)
+            hist_record(hist, cycles[i]);
+    }
+}
+
+int ecall_stack_growth(size_t pages, size_t committed, histogram_t* first, histogram_t* again)
+{
+    uintptr_t entry_sp = (uintptr_t)__builtin_frame_address(0);
+    uint64_t* cycles = (uint64_t*)malloc(pages * sizeof(uint64_t));
+    uintptr_t* address = (uintptr_t*)malloc(pages * sizeof(uintptr_t));
+    int ret = -1;
+
+    if (pages != 0 && cycles != NULL && address != NULL && committed < entry_sp) {
+        uintptr_t grown_below = entry_sp - committed;
+        stack_descend(pages, cycles, address);
+        stack_hist(cycles, address, pages, grown_below, first);
+        stack_descend(pages, cycles, address);
+        stack_hist(cycles, address, pages, grown_below, again);
+        ret = first->count ? 0 : -1;
+    }
+    free(cycles);
+    free(address);
+    return ret;
+}
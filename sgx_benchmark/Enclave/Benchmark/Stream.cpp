@@ -0,0 +1,71 @@
+/* Stream.cpp - trusted side of the STREAM benchmark.
+ *
+ * The same kernels run over arrays in the EPC, where every cache line that
+ * goes to or comes from DRAM passes the memory encryption engine, and over
+ * untrusted arrays of the same size, which do not.
+ */
+
+#include "../Enclave.h"
+#include "Enclave_t.h"
+#include "sgx_lfence.h"
+#include "sgx_trts.h"
+#include "stream_kernels.h"
+
+static double* stream_t[3] = { NULL, NULL, NULL };
+static double* stream_u[3] = { NULL, NULL, NULL };
+static size_t stream_n = 0;
+
+void ecall_stream_release(void)
+{
+    for (int i = 0; i < 3; ++i) {
+        free(stream_t[i]);
+        stream_t[i] = NULL;
+        stream_u[i] = NULL;
+    }
+    stream_n = 0;
+}
+
+int ecall_stream_prepare(size_t n, double* ua, double* ub, double* uc)
+{
+    double* u[3] = { ua, ub, uc };
+    const double init[3] = { 1.0, 2.0, 0.0 };
+
+    ecall_stream_release();
+    if (n == 0 || n % STREAM_BLOCK != 0)
+        return -1;
+    for (int i = 0; i < 3; ++i) {
+        if (((uintptr_t)u[i] & (STREAM_ALIGN - 1)) != 0 || sgx_is_outside_enclave(u[i], n * sizeof(double)) != 1)
+            return -1;
+    }
+    /* fence after sgx_is_outside_enclave check */
+    sgx_lfence();
+
+    for (int i = 0; i < 3; ++i) {
+        stream_t[i] = (double*)memalign(STREAM_ALIGN, n * sizeof(double));
+        if (stream_t[i] == NULL) {
+            ecall_stream_release();
+            return -1;
+        }
+        for (size_t j = 0; j < n; ++j)
+            stream_t[i][j] = init[i];
+        stream_u[i] = u[i];
+    }
+    stream_n = n;
+    return 0;
+}
+
+int ecall_stream_run(int untrusted, int isa, int nt, int op, int passes, uint64_t* cycles)
+{
+    double** arrays = untrusted ? stream_u : stream_t;
+    uint64_t start_tsc;
+
+    if (stream_n == 0 || passes < 1)
+        return -1;
+    for (int p = 0; p < passes; ++p) {
+        start_tsc = rdtsc();
+        if (stream_kernel(isa, nt, op, arrays[0], arrays[1], arrays[2], stream_n) != 0)
+            return -1;
+        cycles[p] = timing_since(start_tsc);
+    }
+    return 0;
+}
@@ -0,0 +1,26 @@
+/* Tcs.cpp - trusted side of the TCS creation benchmark.
+ *
+ * The enclave reads the TSC as soon as the ecall reaches it. When the urts
+ * finds no free TCS it first has the enclave add one (EAUG of the TCS pages,
+ * EMODT, EACCEPT, then its thread data), so the first ecall of a thread
+ * beyond the pool pays for that before it gets here.
+ */
+
+#include "../Enclave.h"
+#include "Enclave_t.h"
+#include "sgx_lfence.h"
+#include "sgx_trts.h"
+
+int ecall_tcs_hold(uint64_t start_tsc, uint64_t* enter_cycles, int* entered, int* stop)
+{
+    *enter_cycles = rdtsc() - start_tsc;
+    if (sgx_is_outside_enclave(entered, sizeof(int)) != 1 || sgx_is_outside_enclave(stop, sizeof(int)) != 1)
+        return -1;
+    /* fence after sgx_is_outside_enclave check */
+    sgx_lfence();
+
+    __atomic_add_fetch(entered, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(stop, __ATOMIC_SEQ_CST) == 0)
+        __builtin_ia32_pause();
+    return 0;
+}
@@ -31,6 +31,10 @@
 
 #include "Enclave.h"
 #include "Enclave_t.h" /* print_string */
+#include "Benchmark/Slab.h"
+#include "histogram.h"
+#include "sgx_lfence.h"
+#include "sgx_trts.h"
 #include <stdarg.h>
 #include <stdio.h> /* vsnprintf */
 #include <string.h>
@@ -50,11 +54,23 @@ int printf(const char* fmt, ...)
     return (int)strnlen(buf, BUFSIZ - 1) + 1;
 }
 
-uint64_t rdtsc()
+timing_t timing = { 0, 0 };
+
+/* heap break when the enclave was loaded, see enclave_heap_used */
+static char* enclave_heap_start = NULL;
+
+/* The App calls it once, right after loading the enclave */
+void ecall_timing_init(uint64_t tsc_hz)
+{
+    if (enclave_heap_start == NULL)
+        enclave_heap_start = (char*)sbrk(0);
+    timing.tsc_hz = tsc_hz;
+    timing.overhead = timing_measure_overhead(1000);
+}
+
+uint64_t enclave_heap_used(void)
 {
-	unsigned int lo, hi;
-	__asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
-	return ((uint64_t)hi << 32) | lo;
+    return (uint64_t)((char*)sbrk(0) - enclave_heap_start);
 }
 
 void ecall_void(void) {}
@@ -65,130 +81,342 @@ void ecall_out(long* out, int len) {}
 
 void ecall_inout(long* inout, int len) {}
 
+/* per-OCALL latencies of the last ecall_ocall_* run */
+static histogram_t ocall_hist;
+
+void ecall_get_ocall_histogram(histogram_t* hist) {
+    *hist = ocall_hist;
+}
+
 void ecall_ocall_void(int loops) {
+    uint64_t start_tsc;
+    hist_reset(&ocall_hist);
     for (int i = 0 ; i < loops; i++) {
+        start_tsc = rdtsc();
         ocall_void();
+        hist_record(&ocall_hist, timing_since(start_tsc));
     }
 }
 
 void ecall_ocall_in(int loops, int len) {
     long* ptr = (long*)malloc(len * sizeof(long));
     assert(ptr != NULL);
+    uint64_t start_tsc;
+    hist_reset(&ocall_hist);
     for (int i = 0 ; i < loops; i++) {
+        start_tsc = rdtsc();
         ocall_in(ptr, len);
+        hist_record(&ocall_hist, timing_since(start_tsc));
     }
+    free(ptr);
 }
 
 void ecall_ocall_out(int loops, int len) {
     long* ptr = (long*)malloc(len * sizeof(long));
     assert(ptr != NULL);
+    uint64_t start_tsc;
+    hist_reset(&ocall_hist);
     for (int i = 0 ; i < loops; i++) {
+        start_tsc = rdtsc();
         ocall_out(ptr, len);
+        hist_record(&ocall_hist, timing_since(start_tsc));
     }
+    free(ptr);
 }
 
 void ecall_ocall_inout(int loops, int len) {
     long* ptr = (long*)malloc(len * sizeof(long));
     assert(ptr != NULL);
+    uint64_t start_tsc;
+    hist_reset(&ocall_hist);
     for (int i = 0 ; i < loops; i++) {
+        start_tsc = rdtsc();
         ocall_inout(ptr, len);
+        hist_record(&ocall_hist, timing_since(start_tsc));
+    }
+    free(ptr);
+}
+
+volatile long payload_sink = 0;
+
+void payload_read(const long* buf, int len) {
+    long sum = 0;
+    for (int i = 0; i < len; ++i) sum += buf[i];
+    payload_sink = sum;
+}
+
+void payload_write(long* buf, int len) {
+    for (int i = 0; i < len; ++i) buf[i] = i;
+}
+
+/* abort unless [buf, buf + len) lies entirely in untrusted memory */
+void check_outside_enclave(const long* buf, int len) {
+    if (len < 0 || sgx_is_outside_enclave(buf, (size_t)len * sizeof(long)) != 1)
+        abort();
+    /* fence after sgx_is_outside_enclave check */
+    sgx_lfence();
+}
+
+void ecall_in_read(long* in, int len) {
+    payload_read(in, len);
+}
+
+void ecall_out_write(long* out, int len) {
+    payload_write(out, len);
+}
+
+void ecall_user_check_read(long* in, int len) {
+    check_outside_enclave(in, len);
+    payload_read(in, len);
+}
+
+void ecall_user_check_write(long* out, int len) {
+    check_outside_enclave(out, len);
+    payload_write(out, len);
+}
+
+void ecall_ocall_in_read(int loops, int len) {
+    long* ptr = (long*)malloc(len * sizeof(long));
+    assert(ptr != NULL);
+    for (int i = 0 ; i < loops; i++) {
+        payload_write(ptr, len);
+        ocall_in_read(ptr, len);
+    }
+    free(ptr);
+}
+
+void ecall_ocall_out_write(int loops, int len) {
+    long* ptr = (long*)malloc(len * sizeof(long));
+    assert(ptr != NULL);
+    for (int i = 0 ; i < loops; i++) {
+        ocall_out_write(ptr, len);
+        payload_read(ptr, len);
+    }
+    free(ptr);
+}
+
+void ecall_ocall_user_check_read(int loops, long* u_buf, int len) {
+    check_outside_enclave(u_buf, len);
+    for (int i = 0 ; i < loops; i++) {
+        payload_write(u_buf, len);
+        ocall_user_check_read(u_buf, len);
+    }
+}
+
+void ecall_ocall_user_check_write(int loops, long* u_buf, int len) {
+    check_outside_enclave(u_buf, len);
+    for (int i = 0 ; i < loops; i++) {
+        ocall_user_check_write(u_buf, len);
+        payload_read(u_buf, len);
+    }
+}
+
+void ecall_void_switchless(void) {}
+
+void ecall_in_switchless(long* in, int len) {}
+
+void ecall_out_switchless(long* out, int len) {}
+
+void ecall_inout_switchless(long* inout, int len) {}
+
+void ecall_ocall_void_switchless(int loops) {
+    for (int i = 0 ; i < loops; i++) {
+        ocall_void_switchless();
+    }
+}
+
+void ecall_ocall_in_switchless(int loops, int len) {
+    long* ptr = (long*)malloc(len * sizeof(long));
+    assert(ptr != NULL);
+    for (int i = 0 ; i < loops; i++) {
+        ocall_in_switchless(ptr, len);
+    }
+    free(ptr);
+}
+
+void ecall_ocall_out_switchless(int loops, int len) {
+    long* ptr = (long*)malloc(len * sizeof(long));
+    assert(ptr != NULL);
+    for (int i = 0 ; i < loops; i++) {
+        ocall_out_switchless(ptr, len);
+    }
+    free(ptr);
+}
+
+void ecall_ocall_inout_switchless(int loops, int len) {
+    long* ptr = (long*)malloc(len * sizeof(long));
+    assert(ptr != NULL);
+    for (int i = 0 ; i < loops; i++) {
+        ocall_inout_switchless(ptr, len);
     }
+    free(ptr);
 }
 
+/* per-iteration latencies of one memory management phase */
+static histogram_t mm_hist;
+
+void print_mm_hist(const char* name, int page_num, int num, const histogram_t* hist) {
+    char percentiles[256];
+    hist_format(hist, percentiles, sizeof(percentiles));
+    printf("%-30s [ %d pages, num: %d]    time is %ld ± %.0f cycles (%.1f ns), per page %.0f cycles, n=%lu, %s\n",
+            name, page_num, num, hist_mean(hist), hist_ci95(hist), timing_ns(hist_mean(hist)),
+            (double)hist_mean(hist) / page_num, (unsigned long)hist->count, percentiles);
+    ocall_result_hist(name, "cycles/page", hist, (double)page_num);
+}
+
+/* Write one byte of every page of the block */
+static void touch_pages(char* p, int size) {
+    for (char* ch_ptr = p; ch_ptr < p + size; ch_ptr += 4096) *(volatile char*)ch_ptr = 'a';
+}
+
+/* memory the benchmark still holds, released by ecall_memory_state_reset */
+static long mm_rsrv_bytes = 0;
+static long mm_sbrk_bytes = 0;
+
+/* Every EDMM step is its own phase, timed per block of page_num pages:
+ *   reserve        sgx_alloc_rsrv_mem, address space only
+ *   first touch    #PF -> EAUG -> EACCEPT of every page
+ *   re-touch       the same writes on committed pages
+ *   extend         sgx_tprotect_rsrv_mem RW -> RWX (EMODPE)
+ *   restrict       sgx_tprotect_rsrv_mem RWX -> R (EMODPR + EACCEPT)
+ *   free           sgx_free_rsrv_mem (EMODT + EACCEPT + EREMOVE)
+ * and the same for the heap: sbrk extend, first touch, sbrk shrink.
+ * Without EDMM reserved memory and heap are committed at load, so first
+ * touch costs what re-touch does.
+ */
 void ecall_memory_management_benchmark(int page_num, int num) {
     int ret;
-    uint64_t start_tsc, stop_tsc;
-    void** pp = (void**)malloc(sizeof(void*) * num);
+    uint64_t start_tsc;
+    void** pp = (void**)calloc(num, sizeof(void*));
     int size = page_num * 4096;
     void* err_ret = (void *)(~(size_t)0);
     uint64_t heap_init_size = 0x100000;
+    char* heap_block;
 
-    start_tsc = rdtsc();
+    hist_reset(&mm_hist);
     for (int i = 0; i < num; ++i) {
+        start_tsc = rdtsc();
         pp[i] = sgx_alloc_rsrv_mem(size);
+        uint64_t cycles = timing_since(start_tsc);
         if (!pp[i]) {
             printf("sgx_alloc_rsrv_mem error in iter %d.\n", i);
             goto out;
         }
-        for (char* ch_ptr = (char*)pp[i]; ch_ptr < (char*)pp[i] + size; ch_ptr += 4096) *ch_ptr = 'a';
+        mm_rsrv_bytes += size;
+        hist_record(&mm_hist, cycles);
     }
-    stop_tsc = rdtsc();
-    printf("%-30s [ %d pages, num: %d]    time is %ld cycles\n", "[sgx_alloc_rsrv_mem]", page_num, num, (stop_tsc - start_tsc) / num);
+    print_mm_hist("[sgx_alloc_rsrv_mem reserve]", page_num, num, &mm_hist);
 
+    hist_reset(&mm_hist);
+    for (int i = 0; i < num; ++i) {
+        start_tsc = rdtsc();
+        touch_pages((char*)pp[i], size);
+        hist_record(&mm_hist, timing_since(start_tsc));
+    }
+    print_mm_hist("[sgx rsrv first touch]", page_num, num, &mm_hist);
+
+    hist_reset(&mm_hist);
+    for (int i = 0; i < num; ++i) {
+        start_tsc = rdtsc();
+        touch_pages((char*)pp[i], size);
+        hist_record(&mm_hist, timing_since(start_tsc));
+    }
+    print_mm_hist("[sgx rsrv re-touch]", page_num, num, &mm_hist);
 
-    start_tsc = rdtsc();
+    hist_reset(&mm_hist);
     for (int i = 0; i < num; ++i) {
+        start_tsc = rdtsc();
         sgx_status_t status = sgx_tprotect_rsrv_mem(pp[i], size, SGX_PROT_READ | SGX_PROT_WRITE | SGX_PROT_EXEC);
         if (status != SGX_SUCCESS) {
             printf("sgx_tprotect_rsrv_mem error when extend in iter %d. sgx_status_t: %d\n", i, status);
             break;
         }
+        hist_record(&mm_hist, timing_since(start_tsc));
     }
-    stop_tsc = rdtsc();
-    printf("%-30s [ %d pages, num: %d]    time is %ld cycles\n", "[sgx tprotect extend]", page_num, num, (stop_tsc - start_tsc) / num);
+    print_mm_hist("[sgx tprotect extend]", page_num, num, &mm_hist);
 
-    start_tsc = rdtsc();
+    hist_reset(&mm_hist);
     for (int i = 0; i < num; ++i) {
+        start_tsc = rdtsc();
         sgx_status_t status = sgx_tprotect_rsrv_mem(pp[i], size, SGX_PROT_READ);
         if (status != SGX_SUCCESS) {
-            printf("sgx_tprotect_rsrv_mem error when extend in iter %d. sgx_status_t: %d\n", i, status);
+            printf("sgx_tprotect_rsrv_mem error when restrict in iter %d. sgx_status_t: %d\n", i, status);
             break;
         }
+        hist_record(&mm_hist, timing_since(start_tsc));
     }
-    stop_tsc = rdtsc();
-    printf("%-30s [ %d pages, num: %d]    time is %ld cycles\n", "[sgx tprotect restrict]", page_num, num, (stop_tsc - start_tsc) / num);
+    print_mm_hist("[sgx tprotect restrict]", page_num, num, &mm_hist);
 
-    start_tsc = rdtsc();
+    hist_reset(&mm_hist);
     for (int i = 0; i < num; ++i) {
+        start_tsc = rdtsc();
         ret = sgx_free_rsrv_mem(pp[i], size);
         if (ret != 0) {
             printf("sgx_free_rsrv_mem error in iter %d.\n", i);
             goto out;
         }
+        hist_record(&mm_hist, timing_since(start_tsc));
+        pp[i] = NULL;
+        mm_rsrv_bytes -= size;
     }
-    stop_tsc = rdtsc();
-    printf("%-30s [ %d pages, num: %d]    time is %ld cycles\n", "[sgx_free_rsrv_mem]", page_num, num, (stop_tsc - start_tsc) / num);
+    print_mm_hist("[sgx_free_rsrv_mem]", page_num, num, &mm_hist);
 
+    free(pp);
     // cost the init heap (HeapMinSize)
     if (sbrk(heap_init_size) == err_ret) {
         printf("enclave sbrk prepare error.\n");
         return;
     }
+    mm_sbrk_bytes += heap_init_size;
 
-    start_tsc = rdtsc();
+    /* the blocks are contiguous, the first one starts at the old break */
+    heap_block = (char*)sbrk(0);
+    hist_reset(&mm_hist);
     for (int i = 0; i < num; ++i) {
+        start_tsc = rdtsc();
         void* p = sbrk(size);
+        uint64_t cycles = timing_since(start_tsc);
         if (p == err_ret) {
             printf("enclave sbrk extend error in iter %d\n", i);
             return;
         }
-        for (char* ch_ptr = (char*)p; ch_ptr < (char*)p + size; ch_ptr += 4096) *ch_ptr = 'a';
+        mm_sbrk_bytes += size;
+        hist_record(&mm_hist, cycles);
+    }
+    print_mm_hist("[sgx sbrk extend]", page_num, num, &mm_hist);
+
+    hist_reset(&mm_hist);
+    for (int i = 0; i < num; ++i) {
+        start_tsc = rdtsc();
+        touch_pages(heap_block + (long)i * size, size);
+        hist_record(&mm_hist, timing_since(start_tsc));
     }
-    stop_tsc = rdtsc();
-    printf("%-30s [ %d pages, num: %d]    time is %ld cycles\n", "[sgx sbrk extend]", page_num, num, (stop_tsc - start_tsc) / num);
-    
-    start_tsc = rdtsc();
+    print_mm_hist("[sgx sbrk first touch]", page_num, num, &mm_hist);
+
+    hist_reset(&mm_hist);
     for (int i = 0; i < num; ++i) {
+        start_tsc = rdtsc();
         void* p = sbrk(-size);
         if (p == err_ret) {
-            printf("enclave sbrk extend error in iter %d\n", i);
+            printf("enclave sbrk shrink error in iter %d\n", i);
             return;
         }
+        mm_sbrk_bytes -= size;
+        hist_record(&mm_hist, timing_since(start_tsc));
     }
-    stop_tsc = rdtsc();
-    printf("%-30s [ %d pages, num: %d]    time is %ld cycles\n", "[sgx sbrk shrink]", page_num, num, (stop_tsc - start_tsc) / num);
+    print_mm_hist("[sgx sbrk shrink]", page_num, num, &mm_hist);
 
     if (sbrk(-heap_init_size) == err_ret) {
         printf("enclave sbrk finish error.\n");
         return;
     }
-
-    free(pp);
+    mm_sbrk_bytes -= heap_init_size;
     return;
 
 out:
     for (int i = 0; i < num; ++i) {
-        if (pp[i]) sgx_free_rsrv_mem(pp[i], size);
+        if (pp[i] && sgx_free_rsrv_mem(pp[i], size) == 0)
+            mm_rsrv_bytes -= size;
     }
     free(pp);
     return;
@@ -343,4 +571,26 @@ void ecall_seq_u_memory_access_benchmark(long bytes_need_access, int block_size)
 
 void ecall_rand_u_memory_access_benchmark(long bytes_need_access, int block_size) {
     rand_memory_access_benchmark(global_u_mem, global_u_mem_size, bytes_need_access, block_size);
+}
+
+/* ecall_memory_state_reset:
+ *   Give back what the memory benchmarks still hold: the trusted access
+ *   buffer, the heap they grew with sbrk, their reserved memory, the
+ *   slab arena and the STREAM arrays. Returns 0 when the enclave is back
+ *   to its initial memory state, 1 when it is not (e.g. a reserved block
+ *   could not be freed) and has to be reloaded.
+ */
+int ecall_memory_state_reset(void) {
+    free(global_t_mem);
+    global_t_mem = NULL;
+    global_t_mem_size = 0;
+    global_u_mem = NULL;
+    global_u_mem_size = 0;
+    ecall_stream_release();
+
+    /* nothing is allocated above the benchmark's own sbrk extensions */
+    if (mm_sbrk_bytes != 0 && sbrk(-mm_sbrk_bytes) != (void*)(~(size_t)0))
+        mm_sbrk_bytes = 0;
+    int slab_held = slab_release() != 0;
+    return (mm_sbrk_bytes != 0 || mm_rsrv_bytes != 0 || slab_held) ? 1 : 0;
 }
\ No newline at end of file
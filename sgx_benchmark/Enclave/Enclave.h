@@ -34,7 +34,9 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include "sgx_error.h"
+#include "timing.h"
 
 #define SGX_PROT_READ	0x1		/* page can be read */
 #define SGX_PROT_WRITE	0x2		/* page can be written */
@@ -52,6 +54,11 @@ extern void* sbrk(__intptr_t n);
 
 int printf(const char* fmt, ...);
 
+/* Heap bytes below the break, from where it was at load: what tlibc malloc
+ * holds, it never lowers the break.
+ */
+uint64_t enclave_heap_used(void);
+
 #if defined(__cplusplus)
 }
 #endif
@@ -0,0 +1,30 @@
+/* alloc_bench.h - allocator benchmark, shared by App and Enclave.
+ *
+ * Every thread of a trial runs `rounds` rounds of:
+ *   allocate `objects` objects of `size` bytes
+ *   free every other one
+ *   allocate them again with 2 * size bytes, which do not fit the holes
+ *   free all of them (the slab allocator frees them in bulk)
+ * sbrk cannot free, it runs the allocations only and counts no free ops.
+ */
+
+#ifndef _ALLOC_BENCH_H_
+#define _ALLOC_BENCH_H_
+
+#include <stdint.h>
+
+#define ALLOC_KIND_SLAB   0 /* size classes on pre-committed reserved memory */
+#define ALLOC_KIND_MALLOC 1 /* tlibc malloc / free */
+#define ALLOC_KIND_SBRK   2 /* one sbrk per object, nothing is freed */
+#define ALLOC_KIND_COUNT  3
+
+typedef struct _alloc_bench_stats_t {
+    uint64_t alloc_ops;
+    uint64_t free_ops;
+    uint64_t alloc_cycles;
+    uint64_t free_cycles;
+    uint64_t live_bytes;  /* requested by all threads, when this one peaked */
+    uint64_t footprint;   /* bytes the allocator held at that moment */
+} alloc_bench_stats_t;
+
+#endif /* !_ALLOC_BENCH_H_ */
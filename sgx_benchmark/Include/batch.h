@@ -0,0 +1,40 @@
+/* batch.h - command buffer format of the batched ECALL (ecall_batch).
+ *
+ * A batch is a packed sequence of commands, each a batch_cmd_t header
+ * followed by payload_len bytes of inline payload, padded to 8 bytes.
+ * The enclave executes the commands in order and writes every result
+ * back into its header; the whole buffer is copied out once.
+ */
+
+#ifndef _BATCH_H_
+#define _BATCH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define BATCH_OP_NOP      0 /* result = 0 */
+#define BATCH_OP_ADD      1 /* result = arg0 + arg1 */
+#define BATCH_OP_CHECKSUM 2 /* result = sum of the payload bytes */
+#define BATCH_OP_FILL     3 /* payload bytes = (uint8_t)arg0, result = payload_len */
+
+#define BATCH_ERROR_OPCODE (-1)
+
+typedef struct _batch_cmd_t {
+    uint32_t opcode;
+    uint32_t payload_len;
+    uint64_t arg0;
+    uint64_t arg1;
+    int64_t result;
+} batch_cmd_t;
+
+static inline size_t batch_cmd_size(uint32_t payload_len)
+{
+    return sizeof(batch_cmd_t) + (((size_t)payload_len + 7) & ~(size_t)7);
+}
+
+static inline uint8_t* batch_cmd_payload(batch_cmd_t* cmd)
+{
+    return (uint8_t*)(cmd + 1);
+}
+
+#endif /* !_BATCH_H_ */
@@ -0,0 +1,19 @@
+/* heap_growth.h - result of one heap growth run (ecall_heap_growth). */
+
+#ifndef _HEAP_GROWTH_H_
+#define _HEAP_GROWTH_H_
+
+#include <stdint.h>
+#include "histogram.h"
+
+typedef struct _heap_growth_t {
+    uint64_t heap_start;       /* heap break before the first malloc */
+    uint64_t heap_end;         /* and after the last one */
+    uint64_t objects;
+    uint64_t steps;            /* mallocs that moved the heap break */
+    uint64_t first_byte;       /* cycles of the first malloc and its first write */
+    histogram_t all;           /* every malloc */
+    histogram_t growth;        /* the mallocs that grew the heap */
+} heap_growth_t;
+
+#endif /* !_HEAP_GROWTH_H_ */
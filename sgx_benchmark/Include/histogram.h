@@ -0,0 +1,133 @@
+/* histogram.h - log-bucketed latency histogram shared by App and Enclave.
+ *
+ * Values below HIST_SUB_BUCKETS are counted exactly; larger values keep their
+ * top HIST_SUB_BUCKET_BITS bits, so every bucket is within 1/32 (~3%) of the
+ * recorded value. The bucket array is fixed size, recording never allocates.
+ */
+
+#ifndef _HISTOGRAM_H_
+#define _HISTOGRAM_H_
+
+#include <math.h>   /* sqrt */
+#include <stdint.h>
+#include <stdio.h>  /* snprintf */
+#include <string.h> /* memset */
+
+#define HIST_SUB_BUCKET_BITS 5
+#define HIST_SUB_BUCKETS     (1 << HIST_SUB_BUCKET_BITS)
+#define HIST_NUM_BUCKETS     (HIST_SUB_BUCKETS * (65 - HIST_SUB_BUCKET_BITS))
+
+typedef struct _histogram_t {
+    uint64_t count;
+    uint64_t sum;
+    double sumsq;
+    uint64_t min;
+    uint64_t max;
+    uint64_t buckets[HIST_NUM_BUCKETS];
+} histogram_t;
+
+static inline void hist_reset(histogram_t* h)
+{
+    memset(h, 0, sizeof(*h));
+    h->min = ~(uint64_t)0;
+}
+
+static inline int hist_bucket_index(uint64_t value)
+{
+    if (value < HIST_SUB_BUCKETS)
+        return (int)value;
+    int msb = 63 - __builtin_clzll(value);
+    int shift = msb - HIST_SUB_BUCKET_BITS;
+    return HIST_SUB_BUCKETS * shift + (int)(value >> shift);
+}
+
+/* Highest value that maps to bucket idx */
+static inline uint64_t hist_bucket_value(int idx)
+{
+    if (idx < HIST_SUB_BUCKETS)
+        return (uint64_t)idx;
+    int shift = idx / HIST_SUB_BUCKETS - 1;
+    uint64_t mant = (uint64_t)(idx % HIST_SUB_BUCKETS + HIST_SUB_BUCKETS);
+    return ((mant + 1) << shift) - 1;
+}
+
+static inline void hist_record(histogram_t* h, uint64_t value)
+{
+    h->buckets[hist_bucket_index(value)]++;
+    h->count++;
+    h->sum += value;
+    h->sumsq += (double)value * (double)value;
+    if (value < h->min) h->min = value;
+    if (value > h->max) h->max = value;
+}
+
+static inline uint64_t hist_mean(const histogram_t* h)
+{
+    return h->count ? h->sum / h->count : 0;
+}
+
+/* Sample standard deviation */
+static inline double hist_stddev(const histogram_t* h)
+{
+    if (h->count < 2)
+        return 0.0;
+    double mean = (double)h->sum / (double)h->count;
+    double var = (h->sumsq - mean * (double)h->sum) / (double)(h->count - 1);
+    return var > 0.0 ? sqrt(var) : 0.0;
+}
+
+/* Half-width of the 95% confidence interval of the mean, treating every
+ * recorded value as an independent sample.
+ */
+static inline double hist_ci95(const histogram_t* h)
+{
+    return h->count > 1 ? 1.96 * hist_stddev(h) / sqrt((double)h->count) : 0.0;
+}
+
+/* Add the values recorded in src to dst */
+static inline void hist_merge(histogram_t* dst, const histogram_t* src)
+{
+    for (int idx = 0; idx < HIST_NUM_BUCKETS; ++idx)
+        dst->buckets[idx] += src->buckets[idx];
+    dst->count += src->count;
+    dst->sum += src->sum;
+    dst->sumsq += src->sumsq;
+    if (src->min < dst->min) dst->min = src->min;
+    if (src->max > dst->max) dst->max = src->max;
+}
+
+/* percentile in [0, 100] */
+static inline uint64_t hist_percentile(const histogram_t* h, double percentile)
+{
+    if (h->count == 0)
+        return 0;
+    uint64_t rank = (uint64_t)(percentile / 100.0 * (double)h->count + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > h->count) rank = h->count;
+
+    uint64_t seen = 0;
+    for (int idx = 0; idx < HIST_NUM_BUCKETS; ++idx) {
+        seen += h->buckets[idx];
+        if (seen >= rank) {
+            uint64_t value = hist_bucket_value(idx);
+            if (value < h->min) value = h->min;
+            if (value > h->max) value = h->max;
+            return value;
+        }
+    }
+    return h->max;
+}
+
+/* Format "min: .. p50: .. p90: .. p99: .. p99.9: .. max: .." into buf */
+static inline int hist_format(const histogram_t* h, char* buf, size_t len)
+{
+    return snprintf(buf, len, "min: %lu, p50: %lu, p90: %lu, p99: %lu, p99.9: %lu, max: %lu",
+            (unsigned long)(h->count ? h->min : 0),
+            (unsigned long)hist_percentile(h, 50.0),
+            (unsigned long)hist_percentile(h, 90.0),
+            (unsigned long)hist_percentile(h, 99.0),
+            (unsigned long)hist_percentile(h, 99.9),
+            (unsigned long)h->max);
+}
+
+#endif /* !_HISTOGRAM_H_ */
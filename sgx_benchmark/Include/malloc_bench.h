@@ -0,0 +1,239 @@
+/* malloc_bench.h - allocator workloads shared by App (glibc) and Enclave (tlibc).
+ *
+ * Both sides compile the same code against their own malloc, so only the
+ * allocator differs. A trial runs malloc_bench_thread once on each of
+ * `nthreads` threads, `ops` operations each; an operation is one malloc and
+ * one free (REALLOC: one realloc):
+ *   SIZES    free + malloc of `size` bytes over a window of 64 live objects
+ *   XFREE    thread pairs, the even thread allocates, the odd one frees
+ *            (objects go through a single-producer single-consumer ring)
+ *   REALLOC  grow one object from 16 bytes to `size` in 64-byte steps
+ *   LARSON   free a random object of a thread's 1024 and allocate a new one
+ *            of 16..size bytes; the arrays move to the next thread every
+ *            trial, so objects are freed by another thread than their own
+ * footprint() (bytes the process or the enclave heap uses, not a delta) is
+ * sampled along the way, peak holds its highest value. *abort (host memory)
+ * becomes non-zero when a thread of the trial never ran, an XFREE partner
+ * waiting for it gives up.
+ */
+
+#ifndef _MALLOC_BENCH_H_
+#define _MALLOC_BENCH_H_
+
+#include <stdint.h>
+#include <stdlib.h>  /* malloc */
+#include <string.h>  /* memset */
+
+#define MALLOC_CASE_SIZES   0
+#define MALLOC_CASE_XFREE   1
+#define MALLOC_CASE_REALLOC 2
+#define MALLOC_CASE_LARSON  3
+#define MALLOC_CASE_COUNT   4
+
+#define MALLOC_MAX_THREADS  64
+#define MALLOC_WINDOW       64
+#define MALLOC_RING_SIZE    1024  /* power of 2 */
+#define MALLOC_LARSON_SLOTS 1024
+#define MALLOC_SAMPLE_OPS   16384 /* ops between footprint samples */
+
+typedef struct _malloc_bench_ring_t {
+    void* slots[MALLOC_RING_SIZE];
+    uint64_t head;  /* written by the producer */
+    char pad[56];
+    uint64_t tail;  /* written by the consumer */
+} malloc_bench_ring_t;
+
+typedef struct _malloc_bench_t {
+    int mcase;
+    int nthreads;
+    size_t size;
+    long ops;
+    uint64_t (*footprint)(void);
+    uint64_t peak;
+    int* abort;
+    malloc_bench_ring_t* rings;                /* one per XFREE pair */
+    void** larson[MALLOC_MAX_THREADS];         /* LARSON objects, one array per thread */
+} malloc_bench_t;
+
+static inline void malloc_bench_sample(malloc_bench_t* b)
+{
+    uint64_t used = b->footprint();
+    uint64_t peak = __atomic_load_n(&b->peak, __ATOMIC_RELAXED);
+    while (used > peak && !__atomic_compare_exchange_n(&b->peak, &peak, used, 0,
+                                                       __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+static inline uint64_t malloc_bench_rand(uint64_t* seed)
+{
+    *seed = *seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    return *seed >> 33;
+}
+
+static inline void malloc_bench_teardown(malloc_bench_t* b)
+{
+    for (int t = 0; t < MALLOC_MAX_THREADS; ++t) {
+        if (b->larson[t] == NULL)
+            continue;
+        for (int s = 0; s < MALLOC_LARSON_SLOTS; ++s)
+            free(b->larson[t][s]);
+        free(b->larson[t]);
+        b->larson[t] = NULL;
+    }
+    free(b->rings);
+    b->rings = NULL;
+}
+
+/* 0 on success, -1 on invalid parameters or out of memory */
+static inline int malloc_bench_setup(malloc_bench_t* b, int mcase, int nthreads, size_t size, long ops,
+                                     uint64_t (*footprint)(void), int* abort)
+{
+    memset(b, 0, sizeof(*b));
+    if (mcase < 0 || mcase >= MALLOC_CASE_COUNT || nthreads < 1 || nthreads > MALLOC_MAX_THREADS ||
+        size < 16 || ops < 1 || (mcase == MALLOC_CASE_XFREE && nthreads % 2 != 0))
+        return -1;
+    b->mcase = mcase;
+    b->nthreads = nthreads;
+    b->size = size;
+    b->ops = ops;
+    b->footprint = footprint;
+    b->peak = footprint();
+    b->abort = abort;
+
+    if (mcase == MALLOC_CASE_XFREE) {
+        b->rings = (malloc_bench_ring_t*)calloc(nthreads / 2, sizeof(malloc_bench_ring_t));
+        if (b->rings == NULL)
+            return -1;
+    } else if (mcase == MALLOC_CASE_LARSON) {
+        uint64_t seed = 1;
+        for (int t = 0; t < nthreads; ++t) {
+            b->larson[t] = (void**)calloc(MALLOC_LARSON_SLOTS, sizeof(void*));
+            if (b->larson[t] == NULL) {
+                malloc_bench_teardown(b);
+                return -1;
+            }
+            for (int s = 0; s < MALLOC_LARSON_SLOTS; ++s)
+                b->larson[t][s] = malloc(16 + malloc_bench_rand(&seed) % (size - 15));
+        }
+    }
+    return 0;
+}
+
+static inline long malloc_bench_sizes(malloc_bench_t* b)
+{
+    void* window[MALLOC_WINDOW] = { NULL };
+    for (long i = 0; i < b->ops; ++i) {
+        int w = (int)(i % MALLOC_WINDOW);
+        free(window[w]);
+        window[w] = malloc(b->size);
+        if (window[w] == NULL)
+            return -1;
+        *(volatile char*)window[w] = (char)i;
+        if (i % MALLOC_SAMPLE_OPS == 0)
+            malloc_bench_sample(b);
+    }
+    malloc_bench_sample(b);
+    for (int w = 0; w < MALLOC_WINDOW; ++w)
+        free(window[w]);
+    return b->ops;
+}
+
+static inline long malloc_bench_xfree(malloc_bench_t* b, int thread)
+{
+    malloc_bench_ring_t* ring = &b->rings[thread / 2];
+    if (thread % 2 == 0) {
+        for (long i = 0; i < b->ops; ++i) {
+            void* p = malloc(b->size);
+            if (p == NULL)
+                p = (void*)1;  /* the consumer stops too */
+            else
+                *(volatile char*)p = (char)i;
+            while (ring->head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == MALLOC_RING_SIZE) {
+                if (__atomic_load_n(b->abort, __ATOMIC_RELAXED)) {
+                    free(p == (void*)1 ? NULL : p);
+                    return -1;
+                }
+                __builtin_ia32_pause();
+            }
+            ring->slots[ring->head % MALLOC_RING_SIZE] = p;
+            __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+            if (p == (void*)1)
+                return -1;
+            if (i % MALLOC_SAMPLE_OPS == 0)
+                malloc_bench_sample(b);
+        }
+    } else {
+        for (long i = 0; i < b->ops; ++i) {
+            while (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == ring->tail) {
+                if (__atomic_load_n(b->abort, __ATOMIC_RELAXED))
+                    return -1;
+                __builtin_ia32_pause();
+            }
+            void* p = ring->slots[ring->tail % MALLOC_RING_SIZE];
+            __atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+            if (p == (void*)1)
+                return -1;
+            free(p);
+        }
+        return 0;  /* the producer counts the pair */
+    }
+    return b->ops;
+}
+
+static inline long malloc_bench_realloc(malloc_bench_t* b)
+{
+    char* p = NULL;
+    size_t len = 0;
+    for (long i = 0; i < b->ops; ++i) {
+        len = (len + 64 > b->size) ? 16 : len + 64;
+        if (len == 16) {
+            free(p);
+            p = NULL;
+        }
+        char* q = (char*)realloc(p, len);
+        if (q == NULL) {
+            free(p);
+            return -1;
+        }
+        p = q;
+        p[len - 1] = (char)i;
+        if (i % MALLOC_SAMPLE_OPS == 0)
+            malloc_bench_sample(b);
+    }
+    malloc_bench_sample(b);
+    free(p);
+    return b->ops;
+}
+
+static inline long malloc_bench_larson(malloc_bench_t* b, int thread, int trial)
+{
+    void** slots = b->larson[(thread + trial) % b->nthreads];
+    uint64_t seed = (uint64_t)thread * 7919 + (uint64_t)trial + 1;
+    for (long i = 0; i < b->ops; ++i) {
+        int s = (int)(malloc_bench_rand(&seed) % MALLOC_LARSON_SLOTS);
+        free(slots[s]);
+        slots[s] = malloc(16 + malloc_bench_rand(&seed) % (b->size - 15));
+        if (slots[s] == NULL)
+            return -1;
+        *(volatile char*)slots[s] = (char)i;
+        if (i % MALLOC_SAMPLE_OPS == 0)
+            malloc_bench_sample(b);
+    }
+    malloc_bench_sample(b);
+    return b->ops;
+}
+
+/* The share of thread `thread` in trial `trial`, returns its ops or -1 */
+static inline long malloc_bench_thread(malloc_bench_t* b, int thread, int trial)
+{
+    if (thread < 0 || thread >= b->nthreads)
+        return -1;
+    switch (b->mcase) {
+    case MALLOC_CASE_SIZES:   return malloc_bench_sizes(b);
+    case MALLOC_CASE_XFREE:   return malloc_bench_xfree(b, thread);
+    case MALLOC_CASE_REALLOC: return malloc_bench_realloc(b);
+    default:                  return malloc_bench_larson(b, thread, trial);
+    }
+}
+
+#endif /* !_MALLOC_BENCH_H_ */
@@ -0,0 +1,182 @@
+/* rpc_ring.h - lock-free message ring in untrusted memory, shared by the
+ * enclave and the host workers of the exitless RPC engine.
+ *
+ * Bounded MPMC queue (one sequence number per slot): any number of
+ * producers and consumers, so the same ring serves as SPSC or MPSC.
+ * Each slot carries one rpc_msg_t and up to payload_size inline bytes.
+ *
+ * The ring memory is untrusted. Its geometry is kept in an rpc_ring_ref_t
+ * owned by each side and never re-read from the shared header, so a
+ * corrupted header can not move slot accesses outside the ring.
+ */
+
+#ifndef _RPC_RING_H_
+#define _RPC_RING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h> /* memcpy */
+
+#define RPC_OP_VOID 0 /* no payload */
+#define RPC_OP_IN   1 /* payload goes with the request, like OCALL [in] */
+#define RPC_OP_OUT  2 /* payload comes back with the completion, like OCALL [out] */
+#define RPC_OP_WAIT 3 /* the worker busy-waits arg cycles, stands in for a slow syscall */
+
+/* How a waiting side polls an empty ring */
+#define RPC_POLL_SPIN  0 /* busy loop */
+#define RPC_POLL_PAUSE 1 /* busy loop with PAUSE */
+#define RPC_POLL_FUTEX 2 /* PAUSE, then host workers sleep on a futex */
+
+/* Polls before a host worker falls back to the futex */
+#define RPC_FUTEX_SPIN_LIMIT 20000
+
+#define RPC_CACHELINE 64
+
+typedef struct _rpc_msg_t {
+    uint64_t id;
+    uint32_t opcode;
+    uint32_t len;     /* payload bytes in this slot, set by rpc_try_enqueue */
+    uint32_t out_len; /* RPC_OP_OUT: payload bytes the reply has to carry */
+    uint32_t reserved;
+    uint64_t arg;
+    int64_t result;
+} rpc_msg_t;
+
+typedef struct _rpc_slot_t {
+    uint64_t seq;
+    uint64_t reserved;
+    rpc_msg_t msg;
+    /* payload follows */
+} rpc_slot_t;
+
+typedef struct _rpc_ring_t {
+    uint64_t capacity;
+    uint64_t payload_size;
+    uint8_t pad0[RPC_CACHELINE - 2 * sizeof(uint64_t)];
+    uint64_t enqueue_pos;
+    uint8_t pad1[RPC_CACHELINE - sizeof(uint64_t)];
+    uint64_t dequeue_pos;
+    uint8_t pad2[RPC_CACHELINE - sizeof(uint64_t)];
+    uint32_t sleepers;   /* workers sleeping on futex_word */
+    uint32_t futex_word;
+    uint8_t pad3[RPC_CACHELINE - 2 * sizeof(uint32_t)];
+    /* slots follow */
+} rpc_ring_t;
+
+typedef struct _rpc_ring_ref_t {
+    rpc_ring_t* ring;
+    uint8_t* slots;
+    uint64_t mask;
+    uint64_t stride;
+    uint64_t payload_size;
+} rpc_ring_ref_t;
+
+static inline uint64_t rpc_slot_stride(uint64_t payload_size)
+{
+    return (sizeof(rpc_slot_t) + payload_size + RPC_CACHELINE - 1) & ~(uint64_t)(RPC_CACHELINE - 1);
+}
+
+static inline uint64_t rpc_ring_bytes(uint64_t capacity, uint64_t payload_size)
+{
+    return sizeof(rpc_ring_t) + capacity * rpc_slot_stride(payload_size);
+}
+
+/* capacity must be a power of two */
+static inline void rpc_ring_ref_init(rpc_ring_ref_t* ref, void* mem, uint64_t capacity, uint64_t payload_size)
+{
+    ref->ring = (rpc_ring_t*)mem;
+    ref->slots = (uint8_t*)mem + sizeof(rpc_ring_t);
+    ref->mask = capacity - 1;
+    ref->stride = rpc_slot_stride(payload_size);
+    ref->payload_size = payload_size;
+}
+
+static inline rpc_slot_t* rpc_slot(const rpc_ring_ref_t* ref, uint64_t pos)
+{
+    return (rpc_slot_t*)(ref->slots + (pos & ref->mask) * ref->stride);
+}
+
+/* Owner side only, before the ring is shared */
+static inline void rpc_ring_init(const rpc_ring_ref_t* ref)
+{
+    memset(ref->ring, 0, sizeof(rpc_ring_t));
+    ref->ring->capacity = ref->mask + 1;
+    ref->ring->payload_size = ref->payload_size;
+    for (uint64_t pos = 0; pos <= ref->mask; ++pos)
+        rpc_slot(ref, pos)->seq = pos;
+}
+
+/* Returns 0 when the ring is full or len exceeds payload_size. msg->len
+ * becomes len, the rest of msg is copied as it is.
+ */
+static inline int rpc_try_enqueue(const rpc_ring_ref_t* ref, const rpc_msg_t* msg, const void* payload, uint32_t len)
+{
+    if (len > ref->payload_size)
+        return 0;
+
+    uint64_t pos = __atomic_load_n(&ref->ring->enqueue_pos, __ATOMIC_RELAXED);
+    for (;;) {
+        rpc_slot_t* slot = rpc_slot(ref, pos);
+        uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        int64_t diff = (int64_t)(seq - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&ref->ring->enqueue_pos, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                slot->msg = *msg;
+                slot->msg.len = len;
+                if (len)
+                    memcpy(slot + 1, payload, len);
+                __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+                return 1;
+            }
+        } else if (diff < 0) {
+            return 0;
+        } else {
+            pos = __atomic_load_n(&ref->ring->enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/* Returns 0 when the ring is empty. At most max_len payload bytes are
+ * copied to payload, msg->len is clamped accordingly.
+ */
+static inline int rpc_try_dequeue(const rpc_ring_ref_t* ref, rpc_msg_t* msg, void* payload, uint32_t max_len)
+{
+    uint64_t pos = __atomic_load_n(&ref->ring->dequeue_pos, __ATOMIC_RELAXED);
+    for (;;) {
+        rpc_slot_t* slot = rpc_slot(ref, pos);
+        uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        int64_t diff = (int64_t)(seq - (pos + 1));
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&ref->ring->dequeue_pos, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                *msg = slot->msg;
+                if (msg->len > ref->payload_size) msg->len = (uint32_t)ref->payload_size;
+                if (msg->len > max_len) msg->len = max_len;
+                if (msg->len)
+                    memcpy(payload, slot + 1, msg->len);
+                __atomic_store_n(&slot->seq, pos + ref->mask + 1, __ATOMIC_RELEASE);
+                return 1;
+            }
+        } else if (diff < 0) {
+            return 0;
+        } else {
+            pos = __atomic_load_n(&ref->ring->dequeue_pos, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+static inline int rpc_ring_pending(const rpc_ring_ref_t* ref)
+{
+    uint64_t pos = __atomic_load_n(&ref->ring->dequeue_pos, __ATOMIC_RELAXED);
+    return __atomic_load_n(&rpc_slot(ref, pos)->seq, __ATOMIC_ACQUIRE) == pos + 1;
+}
+
+/* One poll step of a waiting side; the futex part is host-only */
+static inline void rpc_poll_backoff(int policy)
+{
+    if (policy != RPC_POLL_SPIN)
+        __builtin_ia32_pause();
+}
+
+#endif /* !_RPC_RING_H_ */
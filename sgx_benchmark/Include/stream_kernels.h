@@ -0,0 +1,116 @@
+/* stream_kernels.h - STREAM kernels shared by App and Enclave.
+ *
+ *   copy   c = a
+ *   scale  b = s * c
+ *   add    c = a + b
+ *   triad  a = b + s * c
+ *
+ * One version per instruction set (16, 32 and 64 byte vectors) and per store
+ * kind: regular stores, or non-temporal ones that write around the caches
+ * (no read for ownership of the destination lines). The caller picks the
+ * instruction set from CPUID, the kernels are compiled for it with the target
+ * attribute, so the rest of the code keeps the baseline flags. Arrays are
+ * STREAM_ALIGN aligned and hold a multiple of STREAM_BLOCK doubles.
+ */
+
+#ifndef _STREAM_KERNELS_H_
+#define _STREAM_KERNELS_H_
+
+#include <stddef.h>
+
+#define STREAM_COPY       0
+#define STREAM_SCALE      1
+#define STREAM_ADD        2
+#define STREAM_TRIAD      3
+#define STREAM_OP_COUNT   4
+
+#define STREAM_ISA_SSE2   0
+#define STREAM_ISA_AVX2   1
+#define STREAM_ISA_AVX512 2
+#define STREAM_ISA_COUNT  3
+
+#define STREAM_ALIGN      64
+#define STREAM_BLOCK      32  /* doubles, 4 vectors of the widest kind */
+#define STREAM_SCALAR     3.0
+
+static const char* const stream_op_names[STREAM_OP_COUNT] = { "copy", "scale", "add", "triad" };
+/* arrays read or written per element, STREAM counts bytes the same way */
+static const int stream_op_arrays[STREAM_OP_COUNT] = { 2, 2, 3, 3 };
+static const char* const stream_isa_names[STREAM_ISA_COUNT] = { "sse2", "avx2", "avx512" };
+
+typedef double stream_v2df __attribute__((vector_size(16)));
+typedef double stream_v4df __attribute__((vector_size(32)));
+typedef double stream_v8df __attribute__((vector_size(64)));
+
+#define STREAM_STORES(isa, arch, vec, nt_builtin)                                       \
+__attribute__((target(arch)))                                                           \
+static inline void stream_store_##isa(double* p, vec v) { *(vec*)p = v; }               \
+__attribute__((target(arch)))                                                           \
+static inline void stream_store_nt_##isa(double* p, vec v) { nt_builtin(p, v); }
+
+STREAM_STORES(sse2,   "sse2",    stream_v2df, __builtin_ia32_movntpd)
+STREAM_STORES(avx2,   "avx2",    stream_v4df, __builtin_ia32_movntpd256)
+STREAM_STORES(avx512, "avx512f", stream_v8df, __builtin_ia32_movntpd512)
+
+/* no-tree-loop-distribute-patterns: the copy loop would become a memcpy call */
+#define STREAM_KERNEL(name, arch, vec, store)                                           \
+__attribute__((target(arch), optimize("no-tree-loop-distribute-patterns")))             \
+static inline void name(int op, double* a, double* b, double* c, size_t n, double s)    \
+{                                                                                       \
+    const size_t w = sizeof(vec) / sizeof(double);                                      \
+    size_t i;                                                                           \
+    switch (op) {                                                                       \
+    case STREAM_COPY:                                                                   \
+        _Pragma("GCC unroll 4")                                                         \
+        for (i = 0; i < n; i += w)                                                      \
+            store(c + i, *(const vec*)(a + i));                                         \
+        break;                                                                          \
+    case STREAM_SCALE:                                                                  \
+        _Pragma("GCC unroll 4")                                                         \
+        for (i = 0; i < n; i += w)                                                      \
+            store(b + i, s * *(const vec*)(c + i));                                     \
+        break;                                                                          \
+    case STREAM_ADD:                                                                    \
+        _Pragma("GCC unroll 4")                                                         \
+        for (i = 0; i < n; i += w)                                                      \
+            store(c + i, *(const vec*)(a + i) + *(const vec*)(b + i));                  \
+        break;                                                                          \
+    case STREAM_TRIAD:                                                                  \
+        _Pragma("GCC unroll 4")                                                         \
+        for (i = 0; i < n; i += w)                                                      \
+            store(a + i, *(const vec*)(b + i) + s * *(const vec*)(c + i));              \
+        break;                                                                          \
+    }                                                                                   \
+    __builtin_ia32_sfence();                                                            \
+}
+
+STREAM_KERNEL(stream_sse2,      "sse2",    stream_v2df, stream_store_sse2)
+STREAM_KERNEL(stream_sse2_nt,   "sse2",    stream_v2df, stream_store_nt_sse2)
+STREAM_KERNEL(stream_avx2,      "avx2",    stream_v4df, stream_store_avx2)
+STREAM_KERNEL(stream_avx2_nt,   "avx2",    stream_v4df, stream_store_nt_avx2)
+STREAM_KERNEL(stream_avx512,    "avx512f", stream_v8df, stream_store_avx512)
+STREAM_KERNEL(stream_avx512_nt, "avx512f", stream_v8df, stream_store_nt_avx512)
+
+/* stream_kernel:
+ *   Run op once over n doubles. Returns -1 for an unknown isa or op, the
+ *   caller has to make sure the CPU (and the enclave's XFRM) supports isa.
+ */
+static inline int stream_kernel(int isa, int nt, int op, double* a, double* b, double* c, size_t n)
+{
+    if (op < 0 || op >= STREAM_OP_COUNT)
+        return -1;
+    switch (isa) {
+    case STREAM_ISA_SSE2:
+        (nt ? stream_sse2_nt : stream_sse2)(op, a, b, c, n, STREAM_SCALAR);
+        return 0;
+    case STREAM_ISA_AVX2:
+        (nt ? stream_avx2_nt : stream_avx2)(op, a, b, c, n, STREAM_SCALAR);
+        return 0;
+    case STREAM_ISA_AVX512:
+        (nt ? stream_avx512_nt : stream_avx512)(op, a, b, c, n, STREAM_SCALAR);
+        return 0;
+    }
+    return -1;
+}
+
+#endif /* !_STREAM_KERNELS_H_ */
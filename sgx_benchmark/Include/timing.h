@@ -0,0 +1,77 @@
+/* timing.h - serialized, calibrated TSC reads shared by App and Enclave.
+ *
+ * rdtsc() fences both sides (lfence; rdtsc; lfence): earlier instructions
+ * have completed before the read and later ones do not start ahead of it.
+ * rdtscp() waits for earlier instructions and closes a timed region. CPUID,
+ * the usual serializing instruction, faults inside an enclave.
+ *
+ * timing.overhead is the cost of an empty rdtsc()/rdtscp() pair, taken off
+ * by timing_since(). timing.tsc_hz converts cycles to ns. The App sets both
+ * in timing_init() and hands tsc_hz to the enclave with ecall_timing_init(),
+ * which measures the enclave's own overhead.
+ */
+
+#ifndef _TIMING_H_
+#define _TIMING_H_
+
+#include <stdint.h>
+
+typedef struct _timing_t {
+    uint64_t overhead; /* cycles */
+    uint64_t tsc_hz;   /* 0 until calibrated */
+} timing_t;
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/* defined once by App.cpp and by Enclave.cpp */
+extern timing_t timing;
+
+#if defined(__cplusplus)
+}
+#endif
+
+/* Start of a timed region */
+static inline uint64_t rdtsc(void)
+{
+    uint32_t lo, hi;
+    __asm__ __volatile__ ("lfence\n\trdtsc\n\tlfence" : "=a" (lo), "=d" (hi) :: "memory");
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/* End of a timed region */
+static inline uint64_t rdtscp(void)
+{
+    uint32_t lo, hi, aux;
+    __asm__ __volatile__ ("rdtscp\n\tlfence" : "=a" (lo), "=d" (hi), "=c" (aux) :: "memory");
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/* Cheapest of 'samples' empty regions */
+static inline uint64_t timing_measure_overhead(int samples)
+{
+    uint64_t best = ~(uint64_t)0;
+    for (int i = 0; i < samples; ++i) {
+        uint64_t start_tsc = rdtsc();
+        uint64_t cycles = rdtscp() - start_tsc;
+        if (cycles < best)
+            best = cycles;
+    }
+    return best;
+}
+
+/* Cycles since start_tsc, timer overhead excluded */
+static inline uint64_t timing_since(uint64_t start_tsc)
+{
+    uint64_t cycles = rdtscp() - start_tsc;
+    return cycles > timing.overhead ? cycles - timing.overhead : 0;
+}
+
+/* cycles -> ns, 0 if the TSC is not calibrated */
+static inline double timing_ns(double cycles)
+{
+    return timing.tsc_hz ? cycles * 1e9 / (double)timing.tsc_hz : 0.0;
+}
+
+#endif /* !_TIMING_H_ */
@@ -1,30 +1,9 @@
 #!/bin/bash
+# memory_access over block_size 64..1 on cpu 1, in one process.
+# Run again after an interruption, finished points are skipped.
 
-benchmark(){
-    echo "running sgx benchmark - memory_access."
-    echo "running ./bench ${cpu} memory_access 64"
-    ./bench $cpu memory_access 64
-    sleep 5
-    echo "running ./bench ${cpu} memory_access 32"
-    ./bench $cpu memory_access 32
-    sleep 5
-    echo "running ./bench ${cpu} memory_access 16"
-    ./bench $cpu memory_access 16
-    sleep 5
-    echo "running ./bench ${cpu} memory_access 8"
-    ./bench $cpu memory_access 8
-    sleep 5
-    echo "running ./bench ${cpu} memory_access 4"
-    ./bench $cpu memory_access 4
-    sleep 5
-    echo "running ./bench ${cpu} memory_access 1"
-    ./bench $cpu memory_access 1
-    sleep 5
-}
+file_name="mem_access_result.json"
+make || exit 1
 
-make clean
-cp -v Enclave/mem-access-Enclave.config.xml Enclave/Enclave.config.xml
-make
-
-cpu=1
-benchmark
+echo "running ./bench 1 sweep memory_access --cpus 1 --output ${file_name} --resume"
+./bench 1 sweep memory_access --cpus 1 --output "$file_name" --resume
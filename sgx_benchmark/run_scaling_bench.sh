@@ -0,0 +1,15 @@
+#!/bin/bash
+# ecall_scaling on TCSPolicy 0 and 1 (scaling-tcs0 / scaling-tcs1 configs) in one run.
+
+file_name="scaling_result.txt"
+echo "" > $file_name
+
+# max_threads must not exceed TCSNum in scaling-tcs*-Enclave.config.xml
+max_threads=16
+cpu_list="0-$(( $(nproc) - 1 ))"
+
+make || exit 1
+
+echo "running sgx benchmark - ecall_scaling on configs scaling-tcs0, scaling-tcs1, output is saved to ${file_name}"
+./bench -1 run ecall_scaling --config scaling-tcs0,scaling-tcs1 \
+    --set max_threads=$max_threads --set cpu_list=$cpu_list --set len=128 | tee -a "$file_name"
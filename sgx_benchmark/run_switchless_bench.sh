@@ -0,0 +1,12 @@
+#!/bin/bash
+make
+
+cpu=1
+uworkers=1
+tworkers=1
+echo "running sgx benchmark - switchless."
+for len in 1 16 128 1024 8192 65536; do
+    echo "running ./bench ${cpu} switchless ${uworkers} ${tworkers} ${len}"
+    ./bench $cpu switchless $uworkers $tworkers $len
+    sleep 5
+done